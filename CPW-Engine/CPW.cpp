@@ -19,7 +19,7 @@
 int com_init();
 void setDefaultEval();
 int tt_init();
-int tt_setsize(int size);
+U64 tt_setsize(U64 size);
 
 s_options options;
 etask task;
@@ -28,9 +28,14 @@ void time_uci_go(char * command);
 
 int main() {
     com_init();
+    attacks_init();
     setDefaultEval();
+    search_initReductions();
     tt_init();
 
+	// single-threaded search unless told otherwise
+	options.threads = 1;
+
 	// minimum sizes, in case we don't receive the memory command:
     tt_setsize(0x0400000);     //  4m
     ttpawn_setsize(0x0100000); //  1m
@@ -41,6 +46,11 @@ int main() {
 
 	cv.VariantCapablanca();
     board_loadFromFen(cv.startFEN);
+	cv.FinalizeInit();
+
+	// a table saved earlier, if cpw.ini names one; the file records
+	// the variant, so this can only happen once the variant is set
+	if (options.hash_file[0]) tt_load(options.hash_file);
 
     for(;;) {
 
@@ -8,8 +8,6 @@
 #include "stdafx.h"
 #include "0x88_math.h"
 
-extern bool time_over;
-
 int Quiesce( int alpha, int beta )  {
 
 	CheckInput();
@@ -35,14 +33,13 @@ int Quiesce( int alpha, int beta )  {
     *  come to a definite conclusion about the position. So we have to search *
     **************************************************************************/
 
-    smove movelist[256];
-    U8 mcount = movegen_qs(movelist);
-
-    for (U8 i = 0; i < mcount; i++) {
+    smovepicker mp;
+    smove move;
+    movepicker_initQs(&mp);
 
-        movegen_sort( mcount,movelist, i );
+    while (movepicker_next(&mp, &move)) {
 
-        if ( movelist[i].piece_cap == KING ) return INF;
+        if ( move.piece_cap == KING ) return INF;
 
         /**********************************************************************
         *  Delta cutoff - a move guarentees the score well below alpha, so    *
@@ -50,29 +47,28 @@ int Quiesce( int alpha, int beta )  {
         *  the endgame, because of the insufficient material issues.          *
         **********************************************************************/
 
-        if ( ( stand_pat + e.PIECE_VALUE[movelist[i].piece_cap] + 200 < alpha ) 
-		&&   ( b.piece_material[!b.stm] - e.PIECE_VALUE[movelist[i].piece_cap] > e.ENDGAME_MAT ) 
-		&&   ( !move_isprom(movelist[i]) ) )
+        if ( ( stand_pat + e.PIECE_VALUE[move.piece_cap] + 200 < alpha ) 
+		&&   ( b.piece_material[!b.stm] - e.PIECE_VALUE[move.piece_cap] > e.ENDGAME_MAT ) 
+		&&   ( !move_isprom(move) ) )
             continue;
 
         /**********************************************************************
-        *  badCapture() replaces a cutoff based on the Static Exchange Evalu- *
-        *  ation, marking the place where it ought to be coded. Despite being *
-		*  just a hack, it saves quite a few nodes.                           *
+        *  Skip captures that lose material according to the static exchange *
+        *  evaluation (see.cpp), unless they simplify into a pawn endgame.    *
         **********************************************************************/
 
-        if ( badCapture( movelist[i] )
-        &&  !move_canSimplify( movelist[i] )
-        &&  !move_isprom( movelist[i] ) )
+        if ( !movepicker_seeGe( &mp, move, 0 )
+        &&  !move_canSimplify( move )
+        &&  !move_isprom( move ) )
             continue;
 
         /**********************************************************************
         *  Cutoffs  misfired, we have to search the current move              *
         **********************************************************************/
 
-        move_make( movelist[i] );
+        move_make( move );
         val = -Quiesce( -beta, -alpha );
-        move_unmake( movelist[i] );
+        move_unmake( move );
 
         if (time_over) return 0;
 
@@ -83,35 +79,3 @@ int Quiesce( int alpha, int beta )  {
     }
     return alpha;
 }
-
-int badCapture(smove move) {
-
-    /* captures by pawn do not lose material */
-    if (move.piece_from == PAWN ) return 0;
-
-    /* Captures "lower takes higher" (as well as BxN) are good by definition. */
-    if ( e.PIECE_VALUE[move.piece_cap] >= e.PIECE_VALUE[move.piece_from] - 50 )
-        return 0;
-
-    /**************************************************************************
-    *   When the enemy piece is defended by a pawn, in the quiescence search  *
-    *   we  will  accept rook takes minor, but not minor takes pawn. ( More   *
-    *   exact  version  should accept B/N x P if (a) the pawn  is  the  sole  *
-    *   defender and (b) there is more than one attacker.                     *
-    **************************************************************************/
-
-	if (b.pawn_ctrl[b.color[move.from] ^ 1][move.to]
-	&& e.PIECE_VALUE[move.piece_cap] + 200 < e.PIECE_VALUE[move.piece_from])
-        return 1;
-
-	if (e.PIECE_VALUE[move.piece_cap] + 500 < e.PIECE_VALUE[move.piece_from]) {
-		if (leaperAttack(b.color[move.from] ^ 1, move.to, KNIGHT)) return 1;
-		if (bishAttack(b.color[move.from] ^ 1, move.to, NE)) return 1;
-		if (bishAttack(b.color[move.from] ^ 1, move.to, NW)) return 1;
-		if (bishAttack(b.color[move.from] ^ 1, move.to, SE)) return 1;
-		if (bishAttack(b.color[move.from] ^ 1, move.to, SW)) return 1;
-	}
-
-    /* if a capture is not processed, it cannot be considered bad */
-    return 0;
-}
\ No newline at end of file
@@ -8,9 +8,52 @@
 #include "stdafx.h"
 #include "0x88_math.h"
 
+U8 bb_lineAttacks[8][64];
+sbitboard bb_firstRankAttacks[10][256];
+sbitboard bb_diagMask[NUM_SQUARES];
+sbitboard bb_antiMask[NUM_SQUARES];
+sbitboard bb_betweenTable[80][80];
+
+static constexpr int kingSteps[8] = { SW, SOUTH, SE, WEST, EAST, NW, NORTH, NE };
+static constexpr int knightJumps[8] = { -33, -31, -18, -14, 14, 18, 31, 33 };
+
+static constexpr sbitboard leaperTargets(int sq, const int * jumps) {
+    sbitboard result = { 0, 0 };
+
+    for (int dir = 0; dir < 8; dir++) {
+        int nextSq = sq + jumps[dir];
+        if (nextSq >= 0 && nextSq < NUM_SQUARES && (IS_SQ(nextSq))) {
+            sbitboard bit = bb_square(nextSq);
+            result.lo |= bit.lo;
+            result.hi |= bit.hi;
+        }
+    }
+
+    return result;
+}
+
+static constexpr sleaperTable makeLeaperTable() {
+    sleaperTable table = {};
+
+    for (int sq = 0; sq < NUM_SQUARES; sq++) {
+        if (!IS_SQ(sq)) continue;
+        table.targets[KING][sq]       = leaperTargets(sq, kingSteps);
+        table.targets[KNIGHT][sq]     = leaperTargets(sq, knightJumps);
+        table.targets[ARCHBISHOP][sq] = table.targets[KNIGHT][sq];
+        table.targets[CHANCELLOR][sq] = table.targets[KNIGHT][sq];
+    }
+
+    return table;
+}
+
+constexpr sleaperTable bb_leapers = makeLeaperTable();
+
 
 int isAttacked( char byColor, U8 sq ) {
 
+#ifdef ATTACK_MAPS
+    return b.attacks[byColor][sq] != 0;
+#else
     /* pawns */
     if ( byColor == WHITE && b.pawn_ctrl[WHITE][sq] )
          return 1;
@@ -26,88 +69,170 @@ int isAttacked( char byColor, U8 sq ) {
     if ( leaperAttack( byColor, sq, KING ) )
         return 1;
 
+    /* sliders are looked up in the attack tables (see bitboard.h) */
+    sbitboard occ = b.bb_color[WHITE] | b.bb_color[BLACK];
+
     /* orthogonal sliders (rook, queen, chancellor) */
-    if ( straightAttack( byColor, sq, NORTH ) 
-	||   straightAttack( byColor, sq, SOUTH ) 
-	||   straightAttack( byColor, sq, EAST  ) 
-	||   straightAttack( byColor, sq, WEST  ) )
+    if ( bb_any( bb_rookAttacks( sq, occ ) & b.bb_color[(U8) byColor]
+               & ( b.bb_type[ROOK] | b.bb_type[QUEEN] | b.bb_type[CHANCELLOR] ) ) )
          return 1;
 
     /* diagonal sliders (bishop, queen, archbishop) */
-    if ( diagAttack( byColor, sq, NE ) 
-	||   diagAttack( byColor, sq, SE ) 
-	||   diagAttack( byColor, sq, NW ) 
-	||   diagAttack( byColor, sq, SW ) )
+    if ( bb_any( bb_bishopAttacks( sq, occ ) & b.bb_color[(U8) byColor]
+               & ( b.bb_type[BISHOP] | b.bb_type[QUEEN] | b.bb_type[ARCHBISHOP] ) ) )
          return 1;
 
     return 0;
+#endif
 }
 
 int knightAttack( char byColor, U8 sq ) {
-    U8 nextSq;
-    for ( int dir = 0; dir < num_moves[KNIGHT]; dir++ ) {
-        nextSq = sq + vector[KNIGHT][dir];
-        if ( IS_SQ(nextSq) &&
-		     (isPiece( byColor, KNIGHT, nextSq ) || 
-              isPiece( byColor, ARCHBISHOP, nextSq ) || 
-              isPiece( byColor, CHANCELLOR, nextSq )) )
-            return 1;
-    }
-    return 0;
+    return bb_any( bb_leapers.targets[KNIGHT][sq] & b.bb_color[(U8) byColor]
+                 & ( b.bb_type[KNIGHT] | b.bb_type[ARCHBISHOP] | b.bb_type[CHANCELLOR] ) );
 }
 
 int leaperAttack( char byColor, U8 sq, char byPiece ) {
-    U8 nextSq;
-    for ( int dir = num_slide_moves[byPiece]; dir < num_moves[byPiece]; dir++ ) {
-        nextSq = sq + vector[byPiece][dir];
-        if ( IS_SQ(nextSq) 
-		&&  isPiece( byColor, byPiece, nextSq ) )
-            return 1;
+    return bb_any( bb_leapers.targets[(U8) byPiece][sq] & b.bb_type[(U8) byPiece] & b.bb_color[(U8) byColor] );
+}
+
+/* squares attacked by a piece standing on sq */
+sbitboard pieceAttacks(U8 sq, U8 piece, U8 color, sbitboard occ) {
+    sbitboard result = { 0, 0 };
+
+    if (piece == PAWN) {
+        int left  = color == WHITE ? NW : SW;
+        int right = color == WHITE ? NE : SE;
+        if (IS_SQ(sq + left))  result |= bb_square(sq + left);
+        if (IS_SQ(sq + right)) result |= bb_square(sq + right);
+        return result;
     }
-    return 0;
+
+    if (num_slide_moves[piece]) {
+        if (piece != BISHOP && piece != ARCHBISHOP) result |= bb_rookAttacks(sq, occ);
+        if (piece != ROOK && piece != CHANCELLOR)   result |= bb_bishopAttacks(sq, occ);
+    }
+
+    return result | bb_leapers.targets[piece][sq];
+}
+
+/* pieces of both sides attacking sq, with sliders seeing through occ */
+sbitboard attackersOf(U8 sq, sbitboard occ) {
+    sbitboard target = bb_square(sq);
+
+    return (bb_pawnAttacks(BLACK, target) & b.bb_type[PAWN] & b.bb_color[WHITE])
+         | (bb_pawnAttacks(WHITE, target) & b.bb_type[PAWN] & b.bb_color[BLACK])
+         | (bb_leapers.targets[KNIGHT][sq] & (b.bb_type[KNIGHT] | b.bb_type[ARCHBISHOP] | b.bb_type[CHANCELLOR]))
+         | (bb_leapers.targets[KING][sq] & b.bb_type[KING])
+         | (bb_rookAttacks(sq, occ) & (b.bb_type[ROOK] | b.bb_type[QUEEN] | b.bb_type[CHANCELLOR]))
+         | (bb_bishopAttacks(sq, occ) & (b.bb_type[BISHOP] | b.bb_type[QUEEN] | b.bb_type[ARCHBISHOP]));
+}
+
+#ifdef ATTACK_MAPS
+
+/******************************************************************************
+*  Attack maps count, for every square, the pieces of each side that attack   *
+*  it. Placing or removing a piece changes its own attacks, and also cuts or  *
+*  extends the rays of sliders passing through its square. Both functions are *
+*  called while the square is empty.                                          *
+******************************************************************************/
+
+static void countAttacks(sbitboard targets, U8 color, int delta) {
+    while (bb_any(targets))
+        b.attacks[color][bb_popSquare(targets)] += delta;
 }
 
-int straightAttack(char byColor, U8 sq, int vect) {
-    int nextSq = sq + vect;
+static void crossingSliders(U8 sq, int delta) {
+    sbitboard occ = b.bb_color[WHITE] | b.bb_color[BLACK];
+    sbitboard sliders =
+        (bb_rookAttacks(sq, occ) & (b.bb_type[ROOK] | b.bb_type[QUEEN] | b.bb_type[CHANCELLOR]))
+      | (bb_bishopAttacks(sq, occ) & (b.bb_type[BISHOP] | b.bb_type[QUEEN] | b.bb_type[ARCHBISHOP]));
+
+    while (bb_any(sliders)) {
+        U8 from = bb_popSquare(sliders);
+        U8 color = b.color[from];
+
+        // the ray continues beyond sq, up to and including the first piece
+        int vect = ((COL(sq) > COL(from)) - (COL(sq) < COL(from))) * EAST
+                 + ((ROW(sq) > ROW(from)) - (ROW(sq) < ROW(from))) * NORTH;
 
-    while ( IS_SQ(nextSq) ) {
-        if ( b.color[nextSq] != COLOR_EMPTY ) {
-            if ( (b.color[nextSq] == byColor) 
-			&&   (b.pieces[nextSq] == ROOK || b.pieces[nextSq] == QUEEN || b.pieces[nextSq] == CHANCELLOR) )
-               return 1;
-            return 0;
+        for (int nextSq = sq + vect; IS_SQ(nextSq); nextSq += vect) {
+            b.attacks[color][nextSq] += delta;
+            if (b.color[nextSq] != COLOR_EMPTY) break;
         }
-        nextSq = nextSq + vect;
     }
-    return 0;
 }
 
-int diagAttack(int byColor, U8 sq, int vect) {
-    int nextSq = sq + vect;
+void attacks_place(U8 sq, U8 piece, U8 color) {
+    crossingSliders(sq, -1);
+    countAttacks(pieceAttacks(sq, piece, color, b.bb_color[WHITE] | b.bb_color[BLACK]), color, 1);
+}
 
-    while ( IS_SQ( nextSq ) ) {
-        if ( b.color[ nextSq ] != COLOR_EMPTY ) {
-            if ( (b.color[nextSq] == byColor) 
-			&&   (b.pieces[nextSq] == BISHOP || b.pieces[nextSq] == QUEEN || b.pieces[nextSq] == ARCHBISHOP) )
-               return 1;
-            return 0;
-        }
-        nextSq = nextSq + vect;
+void attacks_remove(U8 sq, U8 piece, U8 color) {
+    countAttacks(pieceAttacks(sq, piece, color, b.bb_color[WHITE] | b.bb_color[BLACK]), color, -1);
+    crossingSliders(sq, 1);
+}
+
+#endif
+
+/******************************************************************************
+*  Filling the sliding attack tables (see bitboard.h). For every position on  *
+*  a line and every occupancy of its inner squares we walk both ways from the *
+*  slider until we hit a piece, which is included as it may be captured.      *
+******************************************************************************/
+
+static int lineAttacks(int pos, int occ, int length) {
+    int result = 0;
+
+    for (int i = pos + 1; i < length; i++) {
+        result |= 1 << i;
+        if (occ & (1 << i)) break;
     }
-    return 0;
+    for (int i = pos - 1; i >= 0; i--) {
+        result |= 1 << i;
+        if (occ & (1 << i)) break;
+    }
+
+    return result;
 }
 
-int bishAttack(int byColor, U8 sq, int vect) {
-	int nextSq = sq + vect;
-
-	while (IS_SQ(nextSq)) {
-		if (b.color[nextSq] != COLOR_EMPTY) {
-			if (b.color[nextSq] == byColor
-			&&  b.pieces[nextSq] == BISHOP)
-				return 1;
-			return 0;
-		}
-		nextSq = nextSq + vect;
-	}
-	return 0;
+static sbitboard lineMask(U8 sq, int vect) {
+    sbitboard mask = bb_square(sq);
+
+    for (int nextSq = sq + vect; IS_SQ(nextSq); nextSq += vect)
+        mask |= bb_square(nextSq);
+    for (int nextSq = sq - vect; IS_SQ(nextSq); nextSq -= vect)
+        mask |= bb_square(nextSq);
+
+    return mask;
+}
+
+void attacks_init() {
+
+    for (int pos = 0; pos < 8; pos++)
+        for (int occ = 0; occ < 64; occ++)
+            bb_lineAttacks[pos][occ] = lineAttacks(pos, occ << 1, 8);
+
+    for (int file = 0; file < NUM_FILES; file++)
+        for (int occ = 0; occ < 256; occ++) {
+            int att = lineAttacks(file, occ << 1, NUM_FILES);
+
+            bb_firstRankAttacks[file][occ] = { 0, 0 };
+            for (int f = 0; f < NUM_FILES; f++)
+                if (att & (1 << f))
+                    bb_firstRankAttacks[file][occ] |= bb_square(SET_SQ(0, f));
+        }
+
+    for (int sq = 0; sq < NUM_SQUARES; sq++) {
+        if (!IS_SQ(sq)) continue;
+        bb_diagMask[sq] = lineMask(sq, NE);
+        bb_antiMask[sq] = lineMask(sq, NW);
+
+        for (int dir = 0; dir < 8; dir++) {
+            sbitboard between = { 0, 0 };
+            for (int nextSq = sq + kingSteps[dir]; IS_SQ(nextSq); nextSq += kingSteps[dir]) {
+                bb_betweenTable[BB_INDEX(sq)][BB_INDEX(nextSq)] = between;
+                between |= bb_square(nextSq);
+            }
+        }
+    }
 }
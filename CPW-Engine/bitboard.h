@@ -0,0 +1,201 @@
+/*  CPW-80 by Greg Strong
+*
+*   Derived from CPW by Pawel Koziol and Edmund Moshammer and
+*   other members of the Chess Programming Wiki.
+*/
+
+#pragma once
+
+/******************************************************************************
+*  Bitboards for the 80-square board. They are kept next to the 0x88-style    *
+*  arrays, so that questions about whole sets of squares (where are the white *
+*  pawns, which squares do they attack, is anything ahead of this pawn) can   *
+*  be answered with a few masks and shifts instead of loops.                  *
+*                                                                             *
+*  Bits are numbered file by file, just like squares: bit = file * 8 + rank.  *
+*  Files a-h live in the low word, files i and j in the low 16 bits of the    *
+*  high word. A step to the north is a shift by 1, a step to the east is a    *
+*  shift by 8. MSVC has no 128-bit integer, so we use a pair of 64-bit words. *
+******************************************************************************/
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+struct sbitboard {
+    U64 lo;   // files a-h
+    U64 hi;   // files i-j
+};
+
+#define BB_HI_MASK   0xFFFFULL
+#define BB_RANK_MASK 0x0101010101010101ULL
+
+/* conversion between 0x88-style squares and bit numbers */
+#define BB_INDEX(sq)   ( (((sq) >> 1) & ~7) | ((sq) & 7) )
+#define BB_SQUARE(bit) ( (((bit) & ~7) << 1) | ((bit) & 7) )
+
+inline sbitboard operator & (sbitboard x, sbitboard y) { return { x.lo & y.lo, x.hi & y.hi }; }
+inline sbitboard operator | (sbitboard x, sbitboard y) { return { x.lo | y.lo, x.hi | y.hi }; }
+inline sbitboard operator ^ (sbitboard x, sbitboard y) { return { x.lo ^ y.lo, x.hi ^ y.hi }; }
+inline sbitboard operator ~ (sbitboard x)              { return { ~x.lo, ~x.hi & BB_HI_MASK }; }
+inline sbitboard & operator |= (sbitboard & x, sbitboard y) { x.lo |= y.lo; x.hi |= y.hi; return x; }
+inline sbitboard & operator ^= (sbitboard & x, sbitboard y) { x.lo ^= y.lo; x.hi ^= y.hi; return x; }
+
+/* shifts by 1..63 bits; bits pushed beyond square j8 are dropped */
+inline sbitboard operator << (sbitboard x, int n) {
+    return { x.lo << n, ((x.hi << n) | (x.lo >> (64 - n))) & BB_HI_MASK };
+}
+
+inline sbitboard operator >> (sbitboard x, int n) {
+    return { (x.lo >> n) | (x.hi << (64 - n)), x.hi >> n };
+}
+
+inline bool bb_any(sbitboard x) { return (x.lo | x.hi) != 0; }
+
+constexpr sbitboard bb_square(U8 sq) {
+    int bit = BB_INDEX(sq);
+    if (bit < 64) return { 1ULL << bit, 0 };
+    return { 0, 1ULL << (bit - 64) };
+}
+
+/* eight bits of a file, given as a byte (bit 0 = rank 1), placed on that file */
+inline sbitboard bb_fileBits(int file, U64 byte) {
+    if (file < 8) return { byte << (file * 8), 0 };
+    return { 0, byte << ((file - 8) * 8) };
+}
+
+inline sbitboard bb_file(int file) { return bb_fileBits(file, 0xFF); }
+inline sbitboard bb_rank(int rank) { return { BB_RANK_MASK << rank, (BB_RANK_MASK << rank) & BB_HI_MASK }; }
+
+/******************************************************************************
+*  Bit counting and bit scanning of a single word. The 64-bit intrinsics of   *
+*  MSVC exist on x64 only (bit scanning also on ARM64), so 32-bit Windows     *
+*  builds work on the two halves of the word instead.                         *
+******************************************************************************/
+
+inline int bb_popcount64(U64 x) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    return (int) __popcnt64(x);
+#elif defined(_MSC_VER) && defined(_M_IX86)
+    return (int) (__popcnt((unsigned int) x) + __popcnt((unsigned int) (x >> 32)));
+#elif defined(_MSC_VER)
+    int n = 0;
+    for (; x; x &= x - 1) n++;
+    return n;
+#else
+    return __builtin_popcountll(x);
+#endif
+}
+
+/* the word must not be empty */
+inline int bb_lsb64(U64 x) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long bit;
+    _BitScanForward64(&bit, x);
+    return (int) bit;
+#elif defined(_MSC_VER)
+    unsigned long bit;
+    if ((unsigned int) x) { _BitScanForward(&bit, (unsigned int) x); return (int) bit; }
+    _BitScanForward(&bit, (unsigned int) (x >> 32));
+    return (int) bit + 32;
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+
+inline int bb_popcount(sbitboard x) {
+    return bb_popcount64(x.lo) + bb_popcount64(x.hi);
+}
+
+/* number of the lowest set bit; the board must not be empty */
+inline int bb_lsb(sbitboard x) {
+    if (x.lo) return bb_lsb64(x.lo);
+    return bb_lsb64(x.hi) + 64;
+}
+
+/* removes the lowest set bit and returns its square */
+inline U8 bb_popSquare(sbitboard & x) {
+    int bit = bb_lsb(x);
+    if (x.lo) x.lo &= x.lo - 1;
+    else      x.hi &= x.hi - 1;
+    return BB_SQUARE(bit);
+}
+
+/* squares attacked by a set of pawns (white pawns capture to the north) */
+inline sbitboard bb_pawnAttacks(int color, sbitboard pawns) {
+    if (color == WHITE) return ((pawns << 9) | (pawns >> 7)) & ~bb_rank(0);
+    else                return ((pawns << 7) | (pawns >> 9)) & ~bb_rank(7);
+}
+
+/******************************************************************************
+*  Sliding attacks are looked up in tables indexed by the occupancy of one    *
+*  line through the square, kindergarten style. A file is a byte of the       *
+*  bitboard already. A diagonal has at most one square per file, so adding up *
+*  its file bytes (a multiplication does that for the low word) collapses it  *
+*  into a byte indexed by rank. A rank is gathered into ten bits with another *
+*  multiplication. The end squares of a line never block anything, so only    *
+*  the inner squares go into the index.                                       *
+*                                                                             *
+*  The tables are filled by attacks_init() in attacks.cpp.                    *
+******************************************************************************/
+
+#define BB_FILE_SUM    0x0101010101010101ULL  // adds up (or copies) file bytes
+#define BB_RANK_GATHER 0x0102040810204080ULL  // moves rank bits to the top byte
+
+extern U8 bb_lineAttacks[8][64];               // 8-square line: position, inner occupancy
+extern sbitboard bb_firstRankAttacks[10][256]; // rank 1: file, inner occupancy
+extern sbitboard bb_diagMask[NUM_SQUARES];
+extern sbitboard bb_antiMask[NUM_SQUARES];
+extern sbitboard bb_betweenTable[80][80];       // by bit number, see bb_between()
+
+/* squares of the lines given as rank bytes, one byte per file */
+inline sbitboard bb_ranksOnLine(U64 byte, sbitboard line) {
+    return { byte * BB_FILE_SUM & line.lo, byte * 0x0101 & line.hi };
+}
+
+inline sbitboard bb_diagAttacks(U8 sq, sbitboard occ, sbitboard line) {
+    occ = occ & line;
+    U64 byte = ((occ.lo * BB_FILE_SUM) >> 56) | ((occ.hi | (occ.hi >> 8)) & 0xFF);
+    return bb_ranksOnLine(bb_lineAttacks[sq & 7][(byte >> 1) & 63], line);
+}
+
+inline sbitboard bb_fileAttacks(U8 sq, sbitboard occ) {
+    int file = sq >> 4;
+    U64 byte = file < 8 ? occ.lo >> (file * 8) : occ.hi >> ((file - 8) * 8);
+    return bb_fileBits(file, bb_lineAttacks[sq & 7][(byte >> 1) & 63]);
+}
+
+inline sbitboard bb_rankAttacks(U8 sq, sbitboard occ) {
+    int rank = sq & 7;
+    U64 lo = (((occ.lo >> rank) & BB_RANK_MASK) * BB_RANK_GATHER) >> 56;
+    U64 hi = (occ.hi >> rank) & 0x0101;
+    U64 bits = lo | ((hi | (hi >> 7)) & 0x3) << 8;
+    sbitboard att = bb_firstRankAttacks[sq >> 4][(bits >> 1) & 0xFF];
+    return { att.lo << rank, att.hi << rank };
+}
+
+/******************************************************************************
+*  Targets of the leaping moves of kings, knights, archbishops and chancel-   *
+*  lors, indexed by piece type and 0x88 square. The table is computed at      *
+*  compile time in attacks.cpp, with jumps off the board already left out.    *
+******************************************************************************/
+
+struct sleaperTable {
+    sbitboard targets[NUM_TYPES][NUM_SQUARES];
+};
+
+extern const sleaperTable bb_leapers;
+
+/* squares strictly between two squares on a line, empty if not on a line */
+inline sbitboard bb_between(U8 sq1, U8 sq2) {
+    return bb_betweenTable[BB_INDEX(sq1)][BB_INDEX(sq2)];
+}
+
+/* attacks of a rook-like and a bishop-like slider standing on sq */
+inline sbitboard bb_rookAttacks(U8 sq, sbitboard occ) {
+    return bb_fileAttacks(sq, occ) | bb_rankAttacks(sq, occ);
+}
+
+inline sbitboard bb_bishopAttacks(U8 sq, sbitboard occ) {
+    return bb_diagAttacks(sq, occ, bb_diagMask[sq]) | bb_diagAttacks(sq, occ, bb_antiMask[sq]);
+}
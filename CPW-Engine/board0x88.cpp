@@ -10,7 +10,8 @@
 #include "transposition.h"
 #include "variant.h"
 
-sboard b;
+sboard boards[MAX_THREADS];
+THREAD_PTR sboard * board_ptr = &boards[0];
 
 void clearBoard() {
 
@@ -21,9 +22,17 @@ void clearBoard() {
         b.color[sq]  = COLOR_EMPTY;
 		for (int cl = 0; cl < 2; cl++) {
 			b.pawn_ctrl[cl][sq] = 0;
+#ifdef ATTACK_MAPS
+			b.attacks[cl][sq] = 0;
+#endif
 		}
     }
 
+    for (int cl = 0; cl < NUM_PLAYERS; cl++)
+        b.bb_color[cl] = { 0, 0 };
+    for (int i = 0; i < NUM_TYPES; i++)
+        b.bb_type[i] = { 0, 0 };
+
     b.castle    = 0;
     b.ep        = 0;
     b.ply       = 0;
@@ -62,15 +71,29 @@ void clearBoard() {
 /******************************************************************************
 * fillSq() and clearSq(), beside placing a piece on a given square or erasing *
 * it,  must  take care for all the incrementally updated  stuff:  hash  keys, *
-* piece counters, material and pcsq values, pawn-related data, king location. *
+* piece counters, material and pcsq values, pawn-related data, king location, *
+* bitboards.                                                                  *
+*                                                                             *
+* The part that describes where the pieces are is done by putSq() and         *
+* takeSq(). move_unmake() uses them alone, since hash keys, material and      *
+* pcsq values are simply copied back from the undo stack.                     *
 ******************************************************************************/
 
-void fillSq(U8 color, U8 piece, U8 sq) {
-	assert(b.pawn_material[0] >= 0);
+void putSq(U8 color, U8 piece, U8 sq) {
+#ifdef ATTACK_MAPS
+    // update attack maps while the square is still empty
+    attacks_place(sq, piece, color);
+#endif
+
     // place a piece on the board
     b.pieces[sq] = piece;
     b.color[sq] = color;
 
+    // update bitboards
+    sbitboard bit = bb_square(sq);
+    b.bb_color[color] |= bit;
+    b.bb_type[piece] |= bit;
+
     // update king location
     if (piece == KING)
         b.king_loc[color] = sq;
@@ -82,12 +105,6 @@ void fillSq(U8 color, U8 piece, U8 sq) {
 	**************************************************************************/
 
     if ( piece == PAWN ) {
-        // update pawn material
-        b.pawn_material[color] += e.PIECE_VALUE[piece];
-
-        // update pawn hashkey
-        b.phash ^= zobrist.piecesquare[piece][color][sq];
-
 		// update counter of pawns on a given rank and file
 		++b.pawns_on_file[color][COL(sq)];
 		++b.pawns_on_rank[color][ROW(sq)];
@@ -101,14 +118,62 @@ void fillSq(U8 color, U8 piece, U8 sq) {
 			if (IS_SQ(sq + SW)) b.pawn_ctrl[BLACK][sq + SW]++;
 		}
     }
+
+    // update piece counter
+    b.piece_cnt[color][piece]++;
+}
+
+void takeSq(U8 sq) {
+
+    U8 color = b.color[sq];
+    U8 piece = b.pieces[sq];
+
+    if ( piece == PAWN ) {
+		// update squares controlled by pawns
+		if (color == WHITE) {
+			if (IS_SQ(sq + NE)) b.pawn_ctrl[WHITE][sq + NE]--;
+			if (IS_SQ(sq + NW)) b.pawn_ctrl[WHITE][sq + NW]--;
+		} else {
+			if (IS_SQ(sq + SE)) b.pawn_ctrl[BLACK][sq + SE]--;
+			if (IS_SQ(sq + SW)) b.pawn_ctrl[BLACK][sq + SW]--;
+		}
+
+		--b.pawns_on_file[color][COL(sq)];
+		--b.pawns_on_rank[color][ROW(sq)];
+    }
+
+    b.piece_cnt[color][piece]--;
+
+    sbitboard bit = bb_square(sq);
+    b.bb_color[color] ^= bit;
+    b.bb_type[piece] ^= bit;
+
+    b.pieces[sq] = PIECE_EMPTY;
+    b.color[sq] = COLOR_EMPTY;
+
+#ifdef ATTACK_MAPS
+    // update attack maps now that the square is empty
+    attacks_remove(sq, piece, color);
+#endif
+}
+
+void fillSq(U8 color, U8 piece, U8 sq) {
+	assert(b.pawn_material[0] >= 0);
+
+    putSq(color, piece, sq);
+
+    if ( piece == PAWN ) {
+        // update pawn material
+        b.pawn_material[color] += e.PIECE_VALUE[piece];
+
+        // update pawn hashkey
+        b.phash ^= zobrist.piecesquare[piece][color][sq];
+    }
     else {
         // update piece material
         b.piece_material[color] += e.PIECE_VALUE[piece];
     }
 
-    // update piece counter
-    b.piece_cnt[color][piece]++;
-
     // update piece-square value
     b.pcsq_mg[color] += e.mgPst[piece][color][sq];
     b.pcsq_eg[color] += e.egPst[piece][color][sq];
@@ -118,7 +183,6 @@ void fillSq(U8 color, U8 piece, U8 sq) {
 	assert(b.pawn_material[0] >= 0);
 }
 
-
 void clearSq(U8 sq) {
 
 	assert(b.pawn_material[0] >= 0);
@@ -131,19 +195,7 @@ void clearSq(U8 sq) {
     b.hash ^= zobrist.piecesquare[piece][color][sq];
 
     if ( piece == PAWN ) {
-		// update squares controlled by pawns
-		if (color == WHITE) {
-			if (IS_SQ(sq + NE)) b.pawn_ctrl[WHITE][sq + NE]--;
-			if (IS_SQ(sq + NW)) b.pawn_ctrl[WHITE][sq + NW]--;
-		} else {
-			if (IS_SQ(sq + SE)) b.pawn_ctrl[BLACK][sq + SE]--;
-			if (IS_SQ(sq + SW)) b.pawn_ctrl[BLACK][sq + SW]--;
-		}
-
-		--b.pawns_on_file[color][COL(sq)];
-		--b.pawns_on_rank[color][ROW(sq)];
         b.pawn_material[color] -= e.PIECE_VALUE[piece];
-
         b.phash ^= zobrist.piecesquare[piece][color][sq];
     }
     else
@@ -152,10 +204,7 @@ void clearSq(U8 sq) {
     b.pcsq_mg[color] -= e.mgPst[piece][color][sq];
     b.pcsq_eg[color] -= e.egPst[piece][color][sq];
 
-    b.piece_cnt[color][piece]--;
-
-    b.pieces[sq] = PIECE_EMPTY;
-    b.color[sq] = COLOR_EMPTY;
+    takeSq(sq);
 	assert(b.pawn_material[0] >= 0);
 }
 
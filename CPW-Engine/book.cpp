@@ -236,7 +236,7 @@ int getBookMove( int book_type ) {
     }
 
     printf("\n");
-    if (result) com_sendmove( book_move );
+    if (result) com_sendmove( book_move, NULL );
 
     return result;
 }
@@ -9,8 +9,6 @@
 
 structtime chronos;
 
-extern bool time_over;
-
 #define TIMEBUFFER 20
 #define MOVESTOGO 40
 
@@ -82,7 +82,7 @@ int input() {
 #include "sys/select.h"
 int com_init()
 {
-
+	return 0;
 }
 
 int input()
@@ -166,6 +166,7 @@ int com_nothing(char * command) {
 	if (!strcmp(command, "xboard"))			com_xboard(command);
 //	else if (!strcmp(command, "uci"))		com_uci(command);
 	else if (!strncmp(command, "variant", 7)) com_xboard(command);
+    else if (!strcmp(command, "perftcheck")) perft_check();
     else if (!strncmp(command,"perft", 5))	perft_start(command);
     else if (!strncmp(command,"bench", 5))	util_bench(command);
     else if (!strcmp(command, "eval"))      printEval();
@@ -176,6 +177,9 @@ int com_nothing(char * command) {
     else if (!strcmp(command, "go"))		time_nothing_go();
     else if (!strcmp(command, "quit"))		exit(0);
     else if (!strcmp(command, "help"))		printHelp();
+    else if (!strncmp(command, "threads", 7)) SetThreads(atoi(command + 8));
+    else if (!strncmp(command, "ttsave ", 7)) tt_dump(command + 7);
+    else if (!strncmp(command, "ttload ", 7)) tt_load(command + 7);
     else if (com_ismove(command) ) {
         if ( algebraic_moves(command) )
             time_nothing_go();
@@ -203,36 +207,76 @@ int com_nothing(char * command) {
 int SetMemorySize(int mb_to_use)
 {
 	static int oldSize = 4;
+	if (mb_to_use < 1) mb_to_use = 1;
+	if (mb_to_use > HASH_MAX_MB) mb_to_use = HASH_MAX_MB;
 	if (mb_to_use == oldSize) 
 		// nothing to do
 		return 0; 
 	// remember current size
 	oldSize = mb_to_use;
-	int mb_used = tt_setsize(mb_to_use * 0x0100000) / 0x0100000;
-	if (mb_used < mb_to_use) {
-		// we have extra space for pawn hash table
-		int spare_mb = mb_to_use - mb_used;
-		mb_used = ttpawn_setsize(spare_mb * 0x0100000) / 0x0100000;
-		if (mb_used < spare_mb)
-			// we have extra space for eval cache
-			tteval_setsize(spare_mb - mb_used);
-		else
-			// we need at least 1 MB for eval cache
-			tteval_setsize(0x0100000); //  1m
-	}
-	else {
-		// we always want at least 1 MB for the pawn table
-		// and 1 MB for the eval cache so things keep working 
-		ttpawn_setsize(0x0100000); //  1m
-		tteval_setsize(0x0100000); //  1m
-	}
+
+	// sizes are 64-bit, so a few gigabytes no longer overflow
+	U64 total = (U64) mb_to_use << 20;
+
+	// the pawn table and the eval cache get 1/32 of the memory each,
+	// but always at least 1 MB so things keep working
+	U64 small = total / 32;
+	if (small < 0x0100000) small = 0x0100000;
+
+	U64 used = ttpawn_setsize(small);
+	used += tteval_setsize(small);
+
+	// tables need not be a power of 2 anymore, so the rest goes to the tt
+	if (total < used + 0x0100000) total = used + 0x0100000;
+	tt_setsize(total - used);
+
+	// resizing has emptied the table, so bring back the saved one
+	if (options.hash_file[0]) tt_load(options.hash_file);
+
+	return 0;
+}
+
+void SetThreads(int threads)
+{
+	if (threads < 1) threads = 1;
+	if (threads > MAX_THREADS) threads = MAX_THREADS;
+	options.threads = threads;
+}
+
+/* the new policy only applies to memory allocated from now on, so all three
+   tables are allocated again at their current sizes - which also clears them */
+void SetNuma(int numa)
+{
+	if (numa == options.numa) return;
+	options.numa = numa;
+	tt_setsize(tt_size * sizeof(stt_bucket));
+	ttpawn_setsize(ptt_size * sizeof(spawntt_entry));
+	tteval_setsize(ett_size * sizeof(sevaltt_entry));
+}
+
+/******************************************************************************
+*  The transposition table file. Once a file is named, the table is loaded    *
+*  from it right away, and again whenever the hash size changes, since the    *
+*  size of the file wins over the hash size anyway. The HashSave button (or   *
+*  the console ttsave command) writes the table back. A name set in cpw.ini   *
+*  is loaded at startup.                                                      *
+******************************************************************************/
+
+void SetHashFile(const char * name)
+{
+	strncpy(options.hash_file, name, sizeof options.hash_file - 1);
+	options.hash_file[sizeof options.hash_file - 1] = 0;
+	if (options.hash_file[0]) tt_load(options.hash_file);
 }
 
 void SendFeatures()
 {
-    printf("feature draw=0 ping=1 analyze=0 reuse=0 sigint=0 sigterm=0 memory=1\n");
+    printf("feature draw=0 ping=1 analyze=0 reuse=0 sigint=0 sigterm=0 memory=1 smp=1\n");
     printf("feature myname=\"CPW-80 1.2\"\n");
     printf("feature variants=\"%s\"\n", cv.variants);
+    printf("feature option=\"NUMA -check 0\"\n");
+    printf("feature option=\"HashFile -file %s\"\n", options.hash_file);
+    printf("feature option=\"HashSave -button\"\n");
     printf("feature done=1\n");
 }
 
@@ -254,6 +298,9 @@ int com_xboard(char * command) {
 		cv.VariantByName(command + 8);
 		board_loadFromFen(cv.startFEN);
 		cv.FinalizeInit();
+
+		// a saved table is only accepted for its own variant, see tt_load()
+		if (options.hash_file[0]) tt_load(options.hash_file);
 	}
 
 	else if (!strncmp(command, "memory", 6))
@@ -261,6 +308,26 @@ int com_xboard(char * command) {
 		SetMemorySize(atoi(command + 7));
 	}
 
+	else if (!strncmp(command, "cores", 5))
+	{
+		SetThreads(atoi(command + 6));
+	}
+
+	else if (!strncmp(command, "option NUMA=", 12))
+	{
+		SetNuma(atoi(command + 12));
+	}
+
+	else if (!strncmp(command, "option HashFile=", 16))
+	{
+		SetHashFile(command + 16);
+	}
+
+	else if (!strcmp(command, "option HashSave"))
+	{
+		if (options.hash_file[0]) tt_dump(options.hash_file);
+	}
+
     else if (!strcmp(command, "new"))
     {
 		task = etask::TASK_FORCE;
@@ -357,8 +424,12 @@ int com_uci(char * command) {
         com_send("id name CPW-80 Engine 1.2");
         com_send("id author Computer Chess Wiki and Greg Strong");
 
-        printf("option name Hash type spin default 64 min 1 max 1024\n");
+        printf("option name Hash type spin default 64 min 1 max %d\n", HASH_MAX_MB);
 		printf("option name Ponder type check default true\n");
+		printf("option name Threads type spin default 1 min 1 max %d\n", MAX_THREADS);
+		printf("option name NUMA type check default false\n");
+		printf("option name HashFile type string default %s\n", options.hash_file[0] ? options.hash_file : "<empty>");
+		printf("option name HashSave type button\n");
         // send options
 
         com_send("uciok");
@@ -374,13 +445,29 @@ int com_uci(char * command) {
 	    if (strstr(command, "setoption name Ponder value"))	
             options.ponder = (strstr(command, "value true") != 0);
 
+	    if (strstr(command, "setoption name NUMA value"))
+            SetNuma(strstr(command, "value true") != 0);
+
+	    if (strstr(command, "setoption name HashFile value ")) {
+            const char * file = strstr(command, "value ") + 6;
+            SetHashFile(strcmp(file, "<empty>") ? file : "");
+        }
+
+	    if (!strcmp(command, "setoption name HashSave") && options.hash_file[0])
+            tt_dump(options.hash_file);
+
 		converted = sscanf(command, "setoption name %s value %s", name, value);
 
         if (!strcmp(name, "Hash")) {
             int val;
             converted = sscanf(value, "%d", &val);
-            tt_setsize(val<<20);
-            ttpawn_setsize(val<<18);
+            SetMemorySize(val);
+        }
+
+        if (!strcmp(name, "Threads")) {
+            int val;
+            converted = sscanf(value, "%d", &val);
+            SetThreads(val);
         }
     }
 
@@ -423,12 +510,12 @@ int com_send(const char * command) {
     return 0;
 }
 
-int com_sendmove(smove m) {
+int com_sendmove(smove m, smove * ponder) {
 
     int promotion = 0;
     char parray[NUM_TYPES] = { 0, 'q', 'r', 'b', 'n', 'p', cv.archbishop, cv.chancellor };
 
-    char command[20];
+    char command[40];
     char move[6];
 
     switch (mode) {
@@ -454,6 +541,12 @@ int com_sendmove(smove m) {
 
     strcat(command, move);
 
+    /* the expected reply, taken from the principal variation */
+    if (ponder && mode == eproto::PROTO_UCI) {
+        strcat(command, " ponder ");
+        algebraic_writemove(*ponder, command + strlen(command));
+    }
+
     com_send(command);
 
     /* in xboard and nothing actually do the move on the board */
@@ -25,12 +25,16 @@ void printHelp() {
     printf("d         =  display current board position \n");
     printf("bench n   =  test search speed to depth n \n");
     printf("perft n   =  test perft numbers up to depth n \n");
+    printf("perftcheck=  test move generation in all variants \n");
     printf("eval      =  display evaluation details \n");
     printf("stat      =  display search statistics \n");
     printf("go        =  play for the side to move \n");
     printf("new       =  start a new game \n");
     printf("sd n      =  set search depth to n plies \n");
     printf("st n      =  set search time to n seconds \n");
+    printf("threads n =  set number of search threads \n");
+    printf("ttsave f  =  save transposition table to file f \n");
+    printf("ttload f  =  load transposition table from file f \n");
     printf("quit      =  exit CPW engine \n");
 	printf("------------------------------------------ \n");
 	printf("variants: \n");
@@ -18,8 +18,6 @@
 
 static const int seventh[NUM_PLAYERS] = { ROW(A7), ROW(A2) };
 static const int eighth[NUM_PLAYERS]  = { ROW(A8), ROW(A1) };
-static const int stepFwd[NUM_PLAYERS] = { NORTH, SOUTH };
-static const int stepBck[NUM_PLAYERS] = { SOUTH, NORTH };
 
 static const U8 player_sq[NUM_PLAYERS][NUM_SQUARES] = { {
         A1, A2, A3, A4, A5, A6, A7, A8,  0,  0,  0,  0,  0,  0,  0,  0,
@@ -84,7 +82,9 @@ struct eval_vector {
     int adjustMaterial[2];
     int blockages[2];
     int positionalThemes[2];
-} v;
+};
+
+thread_local eval_vector v;
 
 int eval( int alpha, int beta, int use_hash ) {
     int result = 0, mgScore = 0, egScore = 0;
@@ -168,37 +168,21 @@ int eval( int alpha, int beta, int use_hash ) {
     *  Evaluate pieces                                                        *
     **************************************************************************/
 
-	for (int x = 0; x < NUM_SQUARES / 2; x++) {
-
-		U8 sq = ((x / NUM_RANKS) * NUM_RANKS * 2) + (x % NUM_RANKS);
-
-		if (b.color[sq] != COLOR_EMPTY) {
-			switch (b.pieces[sq]) {
-			case PAWN: // pawns are evaluated separately
-				break;
-			case KNIGHT:
-				EvalKnight(sq, b.color[sq]);
-				break;
-			case BISHOP:
-				EvalBishop(sq, b.color[sq]);
-				break;
-			case ROOK:
-				EvalRook(sq, b.color[sq]);
-				break;
-			case QUEEN:
-				EvalQueen(sq, b.color[sq]);
-				break;
-			case CHANCELLOR:
-				EvalChancellor(sq, b.color[sq]);
-				break;
-			case ARCHBISHOP:
-				EvalArchbishop(sq, b.color[sq]);
-				break;
-			case KING:
-				break;
-			}
+	// pawns are evaluated separately, kings need no piece eval
+	static void (* const evalPiece[NUM_TYPES])(U8 sq, S8 side) = {
+		0, EvalQueen, EvalRook, EvalBishop, EvalKnight, 0, EvalArchbishop, EvalChancellor
+	};
+
+	for (int side = 0; side < NUM_PLAYERS; side++)
+		for (int piece = 0; piece < NUM_TYPES; piece++) {
+
+			if (!evalPiece[piece]) continue;
+
+			sbitboard pieces = b.bb_type[piece] & b.bb_color[side];
+
+			while (bb_any(pieces))
+				evalPiece[piece](bb_popSquare(pieces), side);
 		}
-	}
 
     /**************************************************************************
     *  Merge  midgame  and endgame score. We interpolate between  these  two  *
@@ -723,19 +707,27 @@ int getPawnScore() {
     return result;
 }
 
+/* pawns of each side and the squares they attack, set up by evalPawnStructure() */
+static thread_local sbitboard pawns[NUM_PLAYERS];
+static thread_local sbitboard pawnAttacks[NUM_PLAYERS];
+
 int evalPawnStructure() {
     int result = 0;
 
-    for (U8 row = 1; row < NUM_RANKS - 1; row++)
-        for (U8 col = 0; col < NUM_FILES; col++) {
+    for (int cl = 0; cl < NUM_PLAYERS; cl++) {
+        pawns[cl] = b.bb_type[PAWN] & b.bb_color[cl];
+        pawnAttacks[cl] = bb_pawnAttacks(cl, pawns[cl]);
+    }
 
-            U8 sq = SET_SQ(row, col);
+    sbitboard todo = b.bb_type[PAWN] & ~(bb_rank(0) | bb_rank(NUM_RANKS - 1));
 
-            if (b.pieces[sq] == PAWN) {
-                if (b.color[sq] == WHITE) result += EvalPawn(sq, WHITE);
-                else                      result -= EvalPawn(sq, BLACK);
-            }
-        }
+    while (bb_any(todo)) {
+
+        U8 sq = bb_popSquare(todo);
+
+        if (b.color[sq] == WHITE) result += EvalPawn(sq, WHITE);
+        else                      result -= EvalPawn(sq, BLACK);
+    }
 
     return result;
 }
@@ -747,49 +739,47 @@ int EvalPawn(U8 sq, S8 side) {
     int flagIsOpposed = 0;
 	
     /**************************************************************************
-    *   We have only very basic data structures that do not update informa-   *
-    *   tion about pawns incrementally, so we have to calculate everything    *
-    *   here.  The loop below detects doubled pawns, passed pawns and sets    *
-    *   a flag on finding that our pawn is opposed by enemy pawn.             *
+    *   Pawn bitboards let us look at the whole file at once. "front" covers  *
+    *   the squares ahead of our pawn, "back" the squares behind it plus the  *
+    *   one in front, so that a pawn in a duo will not be considered weak.    *
     **************************************************************************/
 
-	if (b.pawn_ctrl[!side][sq]) // if a pawn is attacked by a pawn, it is not
-		flagIsPassed = 0;       // passed (not sure if it's the best decision)
-
-	U8 nextSq = sq + stepFwd[side];
+    int row = ROW(sq);
+    U64 frontBits, backBits;
 
-    while (IS_SQ(nextSq)) {
-
-        if (b.pieces[nextSq] == PAWN) { // either opposed by enemy pawn or doubled
-            flagIsPassed = 0;
-            if (b.color[nextSq] == side)
-                result -= 20;       // doubled pawn penalty
-            else
-                flagIsOpposed = 1;  // flag our pawn as opposed
-        }
-
-		if (b.pawn_ctrl[!side][nextSq])
-			flagIsPassed = 0;
-
-        nextSq += stepFwd[side];
+    if (side == WHITE) {
+        frontBits = (0xFF << (row + 1)) & 0xFF;
+        backBits  = (1 << (row + 2)) - 1;
+    } else {
+        frontBits = (1 << row) - 1;
+        backBits  = (0xFF << (row - 1)) & 0xFF;
     }
 
+    sbitboard front = bb_fileBits(COL(sq), frontBits);
+    sbitboard back  = bb_fileBits(COL(sq), backBits);
+
     /**************************************************************************
-    *   Another loop, going backwards and checking whether pawn has support.  *
-    *   Here we can at least break out of it for speed optimization.          *
+    *   Detect doubled pawns and passed pawns, and set a flag on finding      *
+    *   that our pawn is opposed by an enemy pawn. If a pawn or a square in   *
+    *   front of it is attacked by an enemy pawn, it is not passed (not sure  *
+    *   if it's the best decision).                                           *
     **************************************************************************/
 
-    nextSq = sq+stepFwd[side]; // so that a pawn in a duo will not be considered weak
+    result -= 20 * bb_popcount(front & pawns[side]); // doubled pawn penalty
 
-    while (IS_SQ(nextSq)) {
+    if (bb_any(front & pawns[!side]))
+        flagIsOpposed = 1;
 
-		if (b.pawn_ctrl[side][nextSq]) {
-			flagIsWeak = 0;
-			break;
-		}
+    if (bb_any(front & b.bb_type[PAWN])
+    ||  bb_any((front | bb_square(sq)) & pawnAttacks[!side]))
+        flagIsPassed = 0;
 
-        nextSq += stepBck[side];
-    }
+    /**************************************************************************
+    *   Check whether the pawn has support from behind or from the side.      *
+    **************************************************************************/
+
+    if (bb_any(back & pawnAttacks[side]))
+        flagIsWeak = 0;
 
     /**************************************************************************
     *  Evaluate passed pawns, scoring them higher if they are protected       *
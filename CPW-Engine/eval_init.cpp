@@ -279,6 +279,14 @@ void setBasicValues() {
     }
     e.SORT_VALUE[KING] = SORT_KING;
 
+    /* quiescence search generates captures of the most valuable pieces first */
+    for (int i = 0; i < NUM_TYPES; ++i) {
+        int j = i;
+        for (; j > 0 && e.SORT_VALUE[e.VICTIM_ORDER[j - 1]] < e.SORT_VALUE[i]; --j)
+            e.VICTIM_ORDER[j] = e.VICTIM_ORDER[j - 1];
+        e.VICTIM_ORDER[j] = i;
+    }
+
     /* trapped and blocked pieces */
     e.P_KING_BLOCKS_ROOK   =  24;
     e.P_BLOCK_CENTRAL_PAWN =  24;
@@ -487,4 +495,14 @@ void processIniString(char line[250]) {
     /* variables deciding about inner workings of evaluation function */
     else if (!strncmp(line, "ENDGAME_MATERIAL", 16))
 		converted = sscanf(line, "ENDGAME_MATERIAL %d", &e.ENDGAME_MAT);
+
+    /* transposition table file, loaded at startup */
+    else if (!strncmp(line, "HASH_FILE", 9))
+		converted = sscanf(line, "HASH_FILE %255s", options.hash_file);
+
+    /* late move reductions, in hundredths of a ply */
+    else if (!strncmp(line, "LMR_BASE", 8))
+		converted = sscanf(line, "LMR_BASE %d", &LMR_BASE);
+    else if (!strncmp(line, "LMR_DIVISOR", 11))
+		converted = sscanf(line, "LMR_DIVISOR %d", &LMR_DIVISOR);
 }
@@ -38,6 +38,20 @@ int move_unmakeNull(U8 ep) {
 
 int move_make(smove move) {
 
+    /* save the state move_unmake() will copy back */
+    sundo * undo = &b.undo[b.rep_index];
+    undo->hash = b.hash;
+    undo->phash = b.phash;
+    for (int side = 0; side < NUM_PLAYERS; side++) {
+        undo->pcsq_mg[side] = b.pcsq_mg[side];
+        undo->pcsq_eg[side] = b.pcsq_eg[side];
+        undo->piece_material[side] = b.piece_material[side];
+        undo->pawn_material[side] = b.pawn_material[side];
+    }
+    undo->castle = b.castle;
+    undo->ep = b.ep;
+    undo->ply = b.ply;
+
     /* switch the side to move */
     b.stm = !b.stm;
     b.hash ^= zobrist.color;
@@ -67,7 +81,7 @@ int move_make(smove move) {
 	b.castle &= cv.castlingPrivsSquareMask[move.from];
 	b.castle &= cv.castlingPrivsSquareMask[move.to];
 
-	b.hash ^= zobrist.castling[move.castle];
+	b.hash ^= zobrist.castling[undo->castle];
     b.hash ^= zobrist.castling[b.castle];
 
     /**************************************************************************
@@ -121,55 +135,63 @@ int move_make(smove move) {
 
 int move_unmake(smove move) {
 
+    --b.rep_index;
+    const sundo * undo = &b.undo[b.rep_index];
+
     b.stm = !b.stm;
-    b.hash ^= zobrist.color;
 
-    b.ply = move.ply;
+    /**************************************************************************
+    *  Hash keys, material, pcsq values and the rest of the state are copied  *
+    *  back from the undo stack, so the pieces only need to be relocated.     *
+    **************************************************************************/
 
-    /* set en passant square */
-    // if no ep square, ep = 0 and zobrist.ep[0] is 0 so it won't change hashes
-    b.hash ^= zobrist.ep[b.ep];
-    b.hash ^= zobrist.ep[move.ep];
-    b.ep = move.ep;
+    b.hash = undo->hash;
+    b.phash = undo->phash;
+    for (int side = 0; side < NUM_PLAYERS; side++) {
+        b.pcsq_mg[side] = undo->pcsq_mg[side];
+        b.pcsq_eg[side] = undo->pcsq_eg[side];
+        b.piece_material[side] = undo->piece_material[side];
+        b.pawn_material[side] = undo->pawn_material[side];
+    }
+    b.castle = undo->castle;
+    b.ep = undo->ep;
+    b.ply = undo->ply;
 
     /* Move the piece back */
-	clearSq(move.to);
-    fillSq(b.stm, move.piece_from, move.from);
+	takeSq(move.to);
+    putSq(b.stm, move.piece_from, move.from);
 
     /* Un-capture: in case of a capture, put the captured piece back */
 	if ( move_iscapt(move) )
-        fillSq(!b.stm, move.piece_cap, move.to );
+        putSq(!b.stm, move.piece_cap, move.to );
 
     /* Un-castle: the king has already been moved, now move the rook */
     if (move.flags & MFLAG_CASTLE) {
 		if (move.to > move.from) {
-			clearSq(move.to + WEST);
-			fillSq(b.stm, ROOK, cv.rookStartSq[b.stm][1]);
+			takeSq(move.to + WEST);
+			putSq(b.stm, ROOK, cv.rookStartSq[b.stm][1]);
 		} else {
-			clearSq(move.to + EAST);
-			fillSq(b.stm, ROOK, cv.rookStartSq[b.stm][0]);
+			takeSq(move.to + EAST);
+			putSq(b.stm, ROOK, cv.rookStartSq[b.stm][0]);
 		}
     }
 
-    /* adjust castling flags */
-    b.hash ^= zobrist.castling[move.castle];
-    b.hash ^= zobrist.castling[b.castle];
-    b.castle = move.castle;
-
     /* Put the pawn captured en passant back to its initial square */
     if (move.flags & MFLAG_EPCAPTURE) {
         if (b.stm == WHITE) {
-            fillSq(BLACK,PAWN,move.to - 1);
+            putSq(BLACK,PAWN,move.to - 1);
         } else {
-            fillSq(WHITE,PAWN,move.to + 1);
+            putSq(WHITE,PAWN,move.to + 1);
         }
     }
 
-    --b.rep_index;
-
     return 0;
 }
 
+U32 move_encode(smove m) {
+    return m.from | (U32) m.to << 8 | (U32) m.piece_to << 16;
+}
+
 int move_iscapt(smove m) {
     return (m.piece_cap != PIECE_EMPTY);
 }
@@ -188,41 +210,19 @@ int move_canSimplify(smove m) {
 
 int move_countLegal() {
     smove mlist[256];
-    int mcount = movegen(mlist, 0xFF);
-    int result = 0;
-
-    for (int i = 0; i < mcount; i++) {
-
-        /* try a move... */
-        move_make( mlist[i] );
-
-        /* ...then increase the counter if it did not leave us in check */
-        if ( !isAttacked( b.stm, b.king_loc[!b.stm] ) ) ++result;
-
-        move_unmake(mlist[i]);
-    }
 
 	/* return number of legal moves in the current position */
-    return result;
+    return movegen_legal(mlist);
 }
 
 int move_isLegal(smove m) {
     smove movelist[256];
-    int movecount = movegen(movelist, 0xFF);
+    int movecount = movegen_legal(movelist);
 
     for (int i = 0; i < movecount; i++) {
         if ( movelist[i].from == m.from 
-		&&   movelist[i].to   == m.to ) {
-
-            int result = 1;
-
-            /* test if the move in question leaves us in check */
-            move_make( movelist[i] );
-            if ( isAttacked( b.stm, b.king_loc[!b.stm] ) ) result = 0;
-            move_unmake( movelist[i] );
-
-            return result;
-        }
+		&&   movelist[i].to   == m.to )
+            return 1;
     }
 
     return 0;
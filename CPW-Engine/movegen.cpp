@@ -10,9 +10,9 @@
 #include "movegen.h"
 #include "variant.h"
 
-U8 movecount;
+thread_local U8 movecount;
 
-smove * m;
+thread_local smove * m;
 
 char num_moves[NUM_TYPES] = { 8, 8, 4, 4, 8, 0, 12, 12 };
 char num_slide_moves[NUM_TYPES] = { 0, 8, 4, 4, 0, 0, 4, 4 };
@@ -28,13 +28,447 @@ char vector[NUM_TYPES][MAX_DIRECTIONS] = {
 };
 
 
+/******************************************************************************
+*  Moves are generated in three flavours: all of them for the root search     *
+*  and perft, only the "noisy" ones (captures and promotions) for the         *
+*  quiescence search and the first stage of the move picker, and only the     *
+*  quiet ones for its last stage. Noisy and quiet moves together make up      *
+*  exactly the list that movegen() returns.                                   *
+******************************************************************************/
+
 // returns movecount
-U8 movegen(smove * moves, U8 tt_move) {
+U8 movegen(smove * moves) {
+
+    m = moves;
+
+    movecount = 0;
+
+    movegen_castling();
+    movegen_pieces(GEN_ALL);
+
+    return movecount;
+}
+
+/******************************************************************************
+*  movegen_decode() turns a move code read from the transposition table back  *
+*  into a move, provided that it is pseudo-legal in the current position. A   *
+*  hash collision may hand us a code from an unrelated position, so we check  *
+*  the mover, the target square, the path of sliding pieces and the castling  *
+*  conditions, exactly as movegen() would. The move itself is built by        *
+*  movegen_push(), so it gets the same flags and score as a generated one.    *
+******************************************************************************/
+
+int movegen_decode(U32 code, smove * move) {
+
+    U8 from = code & 0xFF;
+    U8 to = (code >> 8) & 0xFF;
+    U8 piece_to = (code >> 16) & 0xFF;
+    U8 flags = MFLAG_NORMAL;
+
+    if (code == NO_MOVE) return 0;
+    if (!IS_SQ(from)) return 0;
+    if (!IS_SQ(to)) return 0;
+    if (b.color[from] != b.stm || b.color[to] == b.stm) return 0;
+
+    U8 piece = b.pieces[from];
+
+    if (piece == PAWN) {
+        int dir = (b.stm == WHITE) ? NORTH : SOUTH;
+        U8 last = (b.stm == WHITE) ? ROW_8 : ROW_1;
+
+        if (to == from + dir) {
+            if (b.pieces[to] != PIECE_EMPTY) return 0;
+        }
+        else if (to == from + 2 * dir) {
+            if (ROW(from) != ((b.stm == WHITE) ? ROW_2 : ROW_7)) return 0;
+            if (b.pieces[from + dir] != PIECE_EMPTY || b.pieces[to] != PIECE_EMPTY) return 0;
+            flags = MFLAG_EP;
+        }
+        else if (to == from + dir + EAST || to == from + dir + WEST) {
+            if (b.color[to] != !b.stm && (to != b.ep || b.ep == 0)) return 0;
+            flags = MFLAG_CAPTURE;
+        }
+        else return 0;
+
+        /* a pawn reaching the last rank must promote to one of the variant's pieces */
+        if (ROW(to) == last) {
+            int nPromotion;
+            for (nPromotion = 0; nPromotion < cv.num_promote_types; nPromotion++)
+                if (cv.promote_types[nPromotion] == piece_to) break;
+            if (nPromotion == cv.num_promote_types) return 0;
+        }
+        else if (piece_to != PAWN) return 0;
+    }
+    else {
+        if (piece_to != piece) return 0;
+
+        if (piece == KING && SAME_ROW(from, to) && abs(COL(to) - COL(from)) > 1) {
+
+            /**********************************************************************
+            *  Castling. The king may go 2-4 files depending on the variant, so   *
+            *  any king move longer than one step must be a castling move. The    *
+            *  squares up to the rook must be empty, and neither the squares the  *
+            *  king passes nor its target may be attacked.                        *
+            **********************************************************************/
+
+            int side = b.stm;
+            int east = COL(to) > COL(from);
+            int steps = abs(COL(to) - COL(from));
+            char right = east ? (side == WHITE ? CASTLE_WK : CASTLE_BK)
+                              : (side == WHITE ? CASTLE_WQ : CASTLE_BQ);
+            U8 rook = cv.rookStartSq[side][east];
+
+            if (from != cv.kingStartSq[side] || !(b.castle & right)) return 0;
+            if (steps < (east ? cv.minCastlingStepsEast : cv.minCastlingStepsWest)) return 0;
+            if (steps > (east ? cv.maxCastlingStepsEast : cv.maxCastlingStepsWest)) return 0;
+
+            int step = east ? 1 : -1;
+            for (int file = COL(from) + step; file != COL(rook); file += step)
+                if (b.color[SET_SQ(ROW(from), file)] != COLOR_EMPTY) return 0;
+
+            for (int file = COL(from); file != COL(to) + step; file += step)
+                if (isAttacked(!side, SET_SQ(ROW(from), file))) return 0;
+
+            flags = MFLAG_CASTLE;
+        }
+        else {
+            /* walk the piece's directions, just like movegen() does */
+            int dir;
+            for (dir = 0; dir < num_moves[piece]; dir++) {
+                U8 pos = from;
+                for (;;) {
+                    pos = pos + vector[piece][dir];
+                    if (!IS_SQ(pos)) break;
+                    if (pos == to) break;
+                    if (b.pieces[pos] != PIECE_EMPTY) break;
+                    if (dir >= num_slide_moves[piece]) break;
+                }
+                if (pos == to) break;
+            }
+            if (dir == num_moves[piece]) return 0;
+
+            if (b.pieces[to] != PIECE_EMPTY) flags = MFLAG_CAPTURE;
+        }
+    }
+
+    /* let movegen_push() fill in the details - promotions produce several moves */
+
+    smove buffer[8];
+    m = buffer;
+    movecount = 0;
+    movegen_push(from, to, piece, b.pieces[to], flags);
+
+    for (int i = 0; i < movecount; i++) {
+        if (buffer[i].piece_to == piece_to) {
+            *move = buffer[i];
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+U8 movegen_qs(smove * moves) {
+
+    m = moves;
+
+    movecount = 0;
+
+    movegen_pieces(GEN_NOISY);
+
+    return movecount;
+}
+
+/******************************************************************************
+*  Quiescence search takes its moves in smaller portions. Captures come one   *
+*  type of victim at a time, found by looking from each victim for our pieces *
+*  that attack it, so that a cutoff on a big capture saves generating the     *
+*  rest. Capturing pawns that reach the last rank promote as usual, and en    *
+*  passant goes with the pawn captures. Promotions without a capture are      *
+*  generated on their own.                                                    *
+******************************************************************************/
+
+U8 movegen_captures(smove * moves, U8 victim) {
+
+    m = moves;
+
+    movecount = 0;
+
+    sbitboard occ = b.bb_color[WHITE] | b.bb_color[BLACK];
+    sbitboard victims = b.bb_type[victim] & b.bb_color[!b.stm];
+
+    while (bb_any(victims)) {
+        U8 to = bb_popSquare(victims);
+        sbitboard attackers = attackersOf(to, occ) & b.bb_color[(U8) b.stm];
+
+        while (bb_any(attackers)) {
+            U8 from = bb_popSquare(attackers);
+            movegen_push(from, to, b.pieces[from], victim, MFLAG_CAPTURE);
+        }
+    }
+
+    if (victim == PAWN && b.ep) {
+        sbitboard attackers = bb_pawnAttacks(!b.stm, bb_square(b.ep)) & b.bb_type[PAWN] & b.bb_color[(U8) b.stm];
+
+        while (bb_any(attackers))
+            movegen_push(bb_popSquare(attackers), b.ep, PAWN, b.pieces[b.ep], MFLAG_CAPTURE);
+    }
+
+    return movecount;
+}
+
+U8 movegen_promotions(smove * moves) {
+
+    m = moves;
+
+    movecount = 0;
+
+    sbitboard pawns = b.bb_type[PAWN] & b.bb_color[(U8) b.stm] & bb_rank(b.stm == WHITE ? ROW_7 : ROW_2);
+
+    while (bb_any(pawns))
+        movegen_pawn_move(bb_popSquare(pawns), GEN_NOISY);
+
+    return movecount;
+}
+
+/******************************************************************************
+*  Check evasions. The king may step to any square that is not attacked once  *
+*  it has left its own square (so that it cannot hide behind itself from a    *
+*  slider). If there is a single checker, other pieces may also capture it    *
+*  or, if it is a slider, step in between. A knight jump, including the one   *
+*  of an archbishop or chancellor, cannot be blocked; it is never on a line   *
+*  with the king, so bb_between() is empty for it anyway. The moves are       *
+*  pseudo-legal; pinned pieces are left to movegen_isLegal() or the search.   *
+******************************************************************************/
+
+U8 movegen_evasions(smove * moves) {
+
+    m = moves;
+
+    movecount = 0;
+
+    U8 king = b.king_loc[(U8) b.stm];
+    sbitboard own = b.bb_color[(U8) b.stm];
+    sbitboard enemy = b.bb_color[!b.stm];
+    sbitboard occ = own | enemy;
+    sbitboard checkers = attackersOf(king, occ) & enemy;
+
+    /* king moves */
+    sbitboard escapes = bb_leapers.targets[KING][king] & ~own;
+    sbitboard occNoKing = occ ^ bb_square(king);
+
+    while (bb_any(escapes)) {
+        U8 to = bb_popSquare(escapes);
+        if (bb_any(attackersOf(to, occNoKing) & enemy)) continue;
+        movegen_push(king, to, KING, b.pieces[to], b.pieces[to] == PIECE_EMPTY ? MFLAG_NORMAL : MFLAG_CAPTURE);
+    }
+
+    /* in a double check only the king can move */
+    if (bb_popcount(checkers) != 1) return movecount;
+
+    U8 checker = BB_SQUARE(bb_lsb(checkers));
+    sbitboard blocks = bb_between(king, checker);
+    sbitboard targets = blocks | checkers;
+
+    /* pawns: pushes onto a blocking square, captures of the checker */
+    int dir = (b.stm == WHITE) ? NORTH : SOUTH;
+    sbitboard pawns = b.bb_type[PAWN] & own;
+
+    while (bb_any(blocks)) {
+        U8 to = bb_popSquare(blocks);
+        U8 from = to - dir;
+
+        if (!IS_SQ(from)) continue;
+
+        if (isPiece(b.stm, PAWN, from))
+            movegen_push(from, to, PAWN, PIECE_EMPTY, MFLAG_NORMAL);
+        else if (b.pieces[from] == PIECE_EMPTY
+             &&  ROW(to) == ((b.stm == WHITE) ? ROW_4 : ROW_5)
+             &&  isPiece(b.stm, PAWN, from - dir))
+            movegen_push(from - dir, to, PAWN, PIECE_EMPTY, MFLAG_EP);
+    }
+
+    sbitboard capturers = bb_pawnAttacks(!b.stm, checkers) & pawns;
+    while (bb_any(capturers))
+        movegen_push(bb_popSquare(capturers), checker, PAWN, b.pieces[checker], MFLAG_CAPTURE);
+
+    /* en passant removes a checking pawn, or may land in between */
+    if (b.ep && (checker == b.ep - dir || bb_any(bb_square(b.ep) & targets))) {
+        capturers = bb_pawnAttacks(!b.stm, bb_square(b.ep)) & pawns;
+        while (bb_any(capturers))
+            movegen_push(bb_popSquare(capturers), b.ep, PAWN, b.pieces[b.ep], MFLAG_CAPTURE);
+    }
+
+    /* other pieces */
+    sbitboard pieces = own & ~(pawns | b.bb_type[KING]);
+
+    while (bb_any(pieces)) {
+        U8 from = bb_popSquare(pieces);
+        sbitboard att = pieceAttacks(from, b.pieces[from], b.stm, occ) & targets;
+
+        while (bb_any(att)) {
+            U8 to = bb_popSquare(att);
+            if (b.pieces[to] == PIECE_EMPTY)
+                movegen_push(from, to, b.pieces[from], PIECE_EMPTY, MFLAG_NORMAL);
+            else
+                movegen_push(from, to, b.pieces[from], b.pieces[to], MFLAG_CAPTURE);
+        }
+    }
+
+    return movecount;
+}
+
+/******************************************************************************
+*  Fully legal moves. Instead of making every move and asking isAttacked()    *
+*  about our king, we find the checkers and the pinned pieces once per node.  *
+*  A piece that is neither pinned nor the king can then only go wrong by not  *
+*  answering a check, which the evasion generator already takes care of. The  *
+*  king must not step onto an attacked square, and a pinned piece must stay   *
+*  on the line between its king and the pinner. En passant may uncover the    *
+*  king along a rank by removing two pawns at once; being rare, it is simply  *
+*  made and tested the old way.                                               *
+******************************************************************************/
+
+/* pieces of one side that stand alone between sq and a slider of the other */
+static sbitboard lineBlockers(U8 sq, int side, int sliders) {
+
+    sbitboard occ = b.bb_color[WHITE] | b.bb_color[BLACK];
+    sbitboard others = b.bb_color[!side];
+    sbitboard result = { 0, 0 };
+
+    /* sliders that would attack sq if the pieces of our side were not there */
+    sbitboard snipers = ((bb_rookAttacks(sq, others) & (b.bb_type[ROOK] | b.bb_type[QUEEN] | b.bb_type[CHANCELLOR]))
+                      |  (bb_bishopAttacks(sq, others) & (b.bb_type[BISHOP] | b.bb_type[QUEEN] | b.bb_type[ARCHBISHOP])))
+                      & b.bb_color[sliders];
+
+    while (bb_any(snipers)) {
+        sbitboard between = bb_between(sq, bb_popSquare(snipers)) & occ;
+        if (bb_popcount(between) == 1) result |= between & b.bb_color[side];
+    }
+
+    return result;
+}
+
+void movegen_pins(spins * pins) {
+
+    U8 king = b.king_loc[(U8) b.stm];
+    sbitboard occ = b.bb_color[WHITE] | b.bb_color[BLACK];
+
+    pins->king = king;
+    pins->checkers = attackersOf(king, occ) & b.bb_color[!b.stm];
+    pins->pinned = lineBlockers(king, b.stm, !b.stm);
+}
+
+int movegen_isLegal(const spins * pins, smove move) {
+
+    if (move.from == pins->king) {
+        /* movegen_castling() has looked at every square the king passes */
+        if (move.flags & MFLAG_CASTLE) return 1;
+
+        /* lift the king off the board, or it would hide a slider's ray behind itself */
+        sbitboard occ = (b.bb_color[WHITE] | b.bb_color[BLACK]) ^ bb_square(pins->king);
+        return !bb_any(attackersOf(move.to, occ) & b.bb_color[!b.stm]);
+    }
+
+    if (move.piece_from == PAWN && move.to == b.ep && b.ep) {
+        move_make(move);
+        int legal = !isAttacked(b.stm, b.king_loc[!b.stm]);
+        move_unmake(move);
+        return legal;
+    }
+
+    sbitboard from = bb_square(move.from);
+    sbitboard to = bb_square(move.to);
+
+    if (bb_any(pins->checkers)) {
+        /* in a double check only the king can move */
+        if (bb_popcount(pins->checkers) > 1) return 0;
+
+        U8 checker = BB_SQUARE(bb_lsb(pins->checkers));
+        if (!bb_any(to & (pins->checkers | bb_between(pins->king, checker)))) return 0;
+    }
+
+    if (!bb_any(pins->pinned & from)) return 1;
+
+    /* stay on the line: either the piece or the target is closer to the king */
+    return bb_any(bb_between(pins->king, move.to) & from)
+        || bb_any(bb_between(pins->king, move.from) & to);
+}
+
+/******************************************************************************
+*  Does a move give check? The squares from which each piece type attacks     *
+*  the enemy king, and our pieces shielding it from our own sliders, are      *
+*  found once per node. A compound piece simply has the knight squares added  *
+*  to those of its slider. Castling, en passant and promotions change the     *
+*  board in more than one place, so they are made and tested the old way.     *
+******************************************************************************/
+
+void movegen_checks(schecks * checks) {
+
+    U8 king = b.king_loc[!b.stm];
+    sbitboard occ = b.bb_color[WHITE] | b.bb_color[BLACK];
+
+    checks->king = king;
+    checks->candidates = lineBlockers(king, b.stm, b.stm);
+
+    for (int type = 0; type < NUM_TYPES; type++)
+        checks->squares[type] = pieceAttacks(king, type, !b.stm, occ);
+
+    /* a king never gives check itself */
+    checks->squares[KING] = { 0, 0 };
+}
+
+int movegen_givesCheck(const schecks * checks, smove move) {
+
+    if ((move.flags & MFLAG_CASTLE)
+    ||  (move.piece_from == PAWN && move.to == b.ep && b.ep)
+    ||   move.piece_to != move.piece_from) {
+        move_make(move);
+        int check = isAttacked(!b.stm, b.king_loc[(U8) b.stm]);
+        move_unmake(move);
+        return check;
+    }
+
+    if (bb_any(checks->squares[move.piece_from] & bb_square(move.to))) return 1;
+
+    if (!bb_any(checks->candidates & bb_square(move.from))) return 0;
+
+    /* a discovered check, unless the piece stays on the line to the king */
+    return !bb_any(bb_between(checks->king, move.to) & bb_square(move.from))
+        && !bb_any(bb_between(checks->king, move.from) & bb_square(move.to));
+}
+
+/* legal moves only, in the order of movegen() or movegen_evasions() */
+U8 movegen_legal(smove * moves) {
+
+    spins pins;
+    movegen_pins(&pins);
+
+    U8 count = bb_any(pins.checkers) ? movegen_evasions(moves) : movegen(moves);
+    U8 legal = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (!movegen_isLegal(&pins, moves[i])) continue;
+        moves[legal++] = moves[i];
+    }
+
+    return legal;
+}
+
+U8 movegen_quiet(smove * moves) {
 
     m = moves;
 
     movecount = 0;
 
+    movegen_castling();
+    movegen_pieces(GEN_QUIET);
+
+    return movecount;
+}
+
+void movegen_castling() {
+
     // Castling
     if ( b.stm == WHITE ) {
         if ( b.castle & CASTLE_WK ) {
@@ -119,93 +553,63 @@ U8 movegen(smove * moves, U8 tt_move) {
 			}
 		}
     }
-
-	// iterate through all squares and generate moves for pieces thereupon
-	for (int x =0; x < NUM_SQUARES/2; x++) {
-
-		U8 sq = ((x / NUM_RANKS) * NUM_RANKS * 2) + (x % NUM_RANKS);
-
-        if (b.color[sq] == b.stm) {
-
-            if (b.pieces[sq] == PAWN) {
-                movegen_pawn_move(sq, 0);
-                movegen_pawn_capt(sq);
-            } else {
-				assert(b.pieces[sq] < (sizeof num_moves / sizeof num_moves[0]) && b.pieces[sq] >= 0);
-                for (char dir=0; dir< num_moves[b.pieces[sq]]; dir++) {
-
-                    for (U8 pos = sq;;) {
-
-                        pos = pos + vector[b.pieces[sq]][dir];
-
-                        if (! IS_SQ(pos)) break;
-
-                        if (b.pieces[pos] == PIECE_EMPTY) {
-                                movegen_push(sq, pos, b.pieces[sq], PIECE_EMPTY, MFLAG_NORMAL);
-						} else {
-							if (b.color[pos] != b.stm) 
-                               movegen_push(sq, pos, b.pieces[sq], b.pieces[pos], MFLAG_CAPTURE);
-                            break; // we're hitting a piece, so looping is over
-                        }
-
-                        if (dir >= num_slide_moves[b.pieces[sq]]) break;
-                    }
-                }
-            }
-        }
-    }
-
-    /* if we have a best-move fed into movegen(), then increase its score */
-
-    if (  ( tt_move != -1 ) && ( tt_move < movecount ) ) moves[tt_move].score = SORT_HASH;
-
-    return movecount;
 }
 
-U8 movegen_qs(smove * moves) {
+void movegen_pieces(U8 kind) {
 
-    m = moves;
+	sbitboard occ = b.bb_color[WHITE] | b.bb_color[BLACK];
 
-    movecount = 0;
+	// pieces may move to empty squares and capture enemy pieces
+	sbitboard targets = { 0, 0 };
+	if (kind != GEN_NOISY) targets |= ~occ;
+	if (kind != GEN_QUIET) targets |= b.bb_color[!b.stm];
 
-    for (U8 sq=0; sq<NUM_SQUARES; sq++) {
+	// our pieces of each type are a list of squares to visit
+	sbitboard pawns = b.bb_type[PAWN] & b.bb_color[(U8) b.stm];
 
-        if (b.color[sq] == b.stm) {
+	while (bb_any(pawns)) {
+		U8 sq = bb_popSquare(pawns);
+		movegen_pawn_move(sq, kind);
+		if (kind != GEN_QUIET) movegen_pawn_capt(sq);
+	}
 
-            if (b.pieces[sq] == PAWN) {
-                movegen_pawn_move(sq, 1);
-                movegen_pawn_capt(sq);
-            } else {
-				assert(b.pieces[sq] < (sizeof num_moves / sizeof num_moves[0]) && b.pieces[sq] >= 0);
-                for (char dir=0; dir< num_moves[b.pieces[sq]]; dir++) {
+	for (U8 piece = 0; piece < NUM_TYPES; piece++) {
 
-                    for (U8 pos = sq;;) {
+		if (piece == PAWN) continue;
 
-                        pos = pos + vector[b.pieces[sq]][dir];
+		bool straight = piece == QUEEN || piece == ROOK || piece == CHANCELLOR;
+		bool diagonal = piece == QUEEN || piece == BISHOP || piece == ARCHBISHOP;
 
-                        if (! IS_SQ(pos)) break;
+		sbitboard pieces = b.bb_type[piece] & b.bb_color[(U8) b.stm];
 
-                        if (b.pieces[pos] != PIECE_EMPTY) {
-                            if (b.color[pos] != b.stm)
-                                movegen_push(sq, pos, b.pieces[sq], b.pieces[pos], MFLAG_CAPTURE);
-                            break; // we're hitting a piece, so looping is over
-                        }
+		while (bb_any(pieces)) {
 
-                        if (dir >= num_slide_moves[b.pieces[sq]]) break;
-                    }
-                }
-            }
-        }
-    }
+			U8 sq = bb_popSquare(pieces);
 
-    return movecount;
+			/* sliding moves come from the attack tables, leaps from the leaper table */
+			sbitboard att = bb_leapers.targets[piece][sq];
+			if (straight) att |= bb_rookAttacks(sq, occ);
+			if (diagonal) att |= bb_bishopAttacks(sq, occ);
+
+			att = att & targets;
+			while (bb_any(att)) {
+				U8 pos = bb_popSquare(att);
+				if (b.pieces[pos] == PIECE_EMPTY)
+					movegen_push(sq, pos, piece, PIECE_EMPTY, MFLAG_NORMAL);
+				else
+					movegen_push(sq, pos, piece, b.pieces[pos], MFLAG_CAPTURE);
+			}
+		}
+	}
 }
 
+void movegen_pawn_move(U8 sq, U8 kind) {
 
-void movegen_pawn_move(U8 sq, bool promotion_only) {
+    /* pushes to the last rank are promotions, so they count as noisy moves */
 
     if ( b.stm == WHITE ) {
-        if (promotion_only && (ROW(sq) != ROW_7)) return;
+        if (kind == GEN_NOISY && (ROW(sq) != ROW_7)) return;
+        if (kind == GEN_QUIET && (ROW(sq) == ROW_7)) return;
 
         if (b.pieces[sq+NORTH] == PIECE_EMPTY) {
             movegen_push(sq, sq+NORTH, PAWN, PIECE_EMPTY, MFLAG_NORMAL);
@@ -215,7 +619,8 @@ void movegen_pawn_move(U8 sq, bool promotion_only) {
                  movegen_push(sq, sq+NORTH+NORTH, PAWN, PIECE_EMPTY, MFLAG_EP);
         }
     } else {
-        if (promotion_only && (ROW(sq) != ROW_2)) return;
+        if (kind == GEN_NOISY && (ROW(sq) != ROW_2)) return;
+        if (kind == GEN_QUIET && (ROW(sq) == ROW_2)) return;
 
         if (b.pieces[sq+SOUTH] == PIECE_EMPTY) {
             movegen_push(sq, sq+SOUTH, PAWN, PIECE_EMPTY, MFLAG_NORMAL);
@@ -254,66 +659,318 @@ void movegen_push(U8 from, U8 to, U8 piece_from, U8 piece_cap, char flags) {
     m[movecount].piece_to = piece_from;
     m[movecount].piece_cap = piece_cap;
     m[movecount].flags = flags;
-    m[movecount].ply = b.ply;
-    m[movecount].castle = b.castle;
-    m[movecount].ep = b.ep;
-    m[movecount].id = movecount;
+
+    if ((piece_from == PAWN) && (to == b.ep) && b.ep != 0)
+        m[movecount].flags = MFLAG_EPCAPTURE;
+
+	/**************************************************************************
+	* Put all possible promotion moves on the list.                           *
+	**************************************************************************/
+
+    if ((piece_from == PAWN) && ( (ROW(to)==ROW_1)||(ROW(to)==ROW_8) )) {
+        m[movecount].flags |= MFLAG_PROMOTION;
+
+        for (int nPromotion = 0; nPromotion < cv.num_promote_types; nPromotion++) {
+            m[movecount+nPromotion] = m[movecount];
+            m[movecount+nPromotion].piece_to = cv.promote_types[nPromotion];
+        }
+        movecount += cv.num_promote_types - 1;
+    }
+
+    movecount++;
+}
+
+/* "see" (may be NULL) gets the SEE verdict of a capture, see esee */
+int movegen_score(smove move, U8 * see) {
 
 	/**************************************************************************
 	* Quiet moves are sorted by history score.                                *
 	**************************************************************************/
 
-    m[movecount].score = sd.history[b.stm][from][to];
+    int score = sd.history[(U8) b.stm][move.from][move.to];
 
     /**************************************************************************
 	* Score for captures: add the value of the captured piece and the id      *
 	* of the attacking piece. If two pieces attack the same target, the one   *
 	* with the higher id (eg. Pawn=5) gets searched first. En passant gets    *
 	* the same score as pawn takes pawn. Good captures are put at the front   *
-	* of the list, bad captures - after ordinary moves.                       *
+	* of the list, bad captures (losing material by SEE) - after ordinary     *
+	* moves.                                                                  *
     **************************************************************************/
 
-	if (piece_cap != PIECE_EMPTY) {
-		if (Blind(m[movecount]) == 0) m[movecount].score = e.SORT_VALUE[piece_cap] + piece_from;
-		else                          m[movecount].score = SORT_CAPT + e.SORT_VALUE[piece_cap] + piece_from;
+	U8 verdict = SEE_UNKNOWN;
+	if (move.piece_cap != PIECE_EMPTY) {
+		verdict = see_ge(move, 0) ? SEE_GOOD : SEE_BAD;
+		if (verdict == SEE_BAD) score = e.SORT_VALUE[move.piece_cap] + move.piece_from;
+		else                    score = SORT_CAPT + e.SORT_VALUE[move.piece_cap] + move.piece_from;
 	}
+	if (see) *see = verdict;
 
-    if ((piece_from == PAWN) && (to == b.ep) && b.ep != 0) {
-        m[movecount].score = SORT_CAPT + e.SORT_VALUE[PAWN] + 5;
-        m[movecount].flags = MFLAG_EPCAPTURE;
+    if (move.flags & MFLAG_EPCAPTURE)
+        score = SORT_CAPT + e.SORT_VALUE[PAWN] + 5;
+
+    if (move.flags & MFLAG_PROMOTION)
+        score += SORT_PROM + e.SORT_VALUE[move.piece_to];
+
+    return score;
+}
+
+void movepicker_init(smovepicker * mp, smove * hash_move, U8 ply) {
+    mp->count = 0;
+    mp->current = 0;
+    mp->stage = PICK_HASH;
+    mp->ply = ply;
+    mp->hash_move = hash_move ? move_encode(*hash_move) : NO_MOVE;
+    if (hash_move) mp->hash = *hash_move;
+    mp->killer[0] = NO_MOVE;
+    mp->killer[1] = NO_MOVE;
+    mp->see = SEE_UNKNOWN;
+}
+
+void movepicker_initEvasions(smovepicker * mp, smove * hash_move, U8 ply) {
+    movepicker_init(mp, hash_move, ply);
+    mp->stage = PICK_EVASION_HASH;
+}
+
+void movepicker_initQs(smovepicker * mp) {
+    movepicker_init(mp, NULL, 0);
+    mp->stage = PICK_QS_CAPTURES;
+    mp->victim = 0;
+}
+
+/* make keys for the moves generated from "first" on; a new stage starts */
+void movepicker_addKeys(smovepicker * mp, int first) {
+    for (int i = first; i < mp->count; i++) {
+        U8 see;
+        int score = movegen_score(mp->moves[i], &see);
+        mp->keys[i] = PICK_KEY(score, see, i);
     }
 
-	/**************************************************************************
-	* Put all possible promotion moves on the list and score them.            *
-	**************************************************************************/
+    mp->picks = 0;
+    mp->sorted = 0;
+}
 
-    if ((piece_from == PAWN) && ( (ROW(to)==ROW_1)||(ROW(to)==ROW_8) )) {
-        m[movecount].flags |= MFLAG_PROMOTION;
+/******************************************************************************
+*  Returns the index of the best move not handed out yet and puts its key at  *
+*  mp->current. A cutoff usually comes early, so the first few picks of a     *
+*  stage just scan the keys for the highest one. If there is no cutoff by     *
+*  then, we are probably in an all-node, where every move will be tried, so   *
+*  the rest of the stage is insertion-sorted once and read off in order.      *
+*  Either way the moves come out exactly by falling key.                      *
+******************************************************************************/
 
-        for (int nPromotion = 0; nPromotion < cv.num_promote_types; nPromotion++) {
-            m[movecount+nPromotion] = m[movecount];
-            m[movecount+nPromotion].piece_to = cv.promote_types[nPromotion];
-            m[movecount+nPromotion].score += SORT_PROM + e.SORT_VALUE[cv.promote_types[nPromotion]];
-            m[movecount+nPromotion].id = movecount+nPromotion;
+int movepicker_best(smovepicker * mp) {
+
+    if (!mp->sorted) {
+        if (mp->picks < PICK_SCANS) {
+            mp->picks++;
+
+            int high = mp->current;
+            for (int i = mp->current + 1; i < mp->count; i++)
+                if (mp->keys[i] > mp->keys[high]) high = i;
+
+            S64 temp = mp->keys[high];
+            mp->keys[high] = mp->keys[mp->current];
+            mp->keys[mp->current] = temp;
+        }
+        else {
+            for (int i = mp->current + 1; i < mp->count; i++) {
+                S64 key = mp->keys[i];
+                int j = i;
+                for (; j > mp->current && mp->keys[j - 1] < key; j--)
+                    mp->keys[j] = mp->keys[j - 1];
+                mp->keys[j] = key;
+            }
+            mp->sorted = 1;
         }
-        movecount += cv.num_promote_types - 1;
     }
 
-    movecount++;
+    return PICK_INDEX(mp->keys[mp->current]);
 }
 
-void movegen_sort(U8 movecount, smove * m, U8 current) {
+// returns 0 when there are no more moves
+int movepicker_next(smovepicker * mp, smove * move) {
+
+    /* moves handed out from the keys take their verdict along */
+    mp->see = SEE_UNKNOWN;
+
+    switch (mp->stage) {
+
+    case PICK_HASH:
+
+        /* the hash move has already been validated by the caller */
+
+        mp->stage = PICK_CAPTURES_GEN;
+        if (mp->hash_move != NO_MOVE) {
+            *move = mp->hash;
+            return 1;
+        }
+        // fall through
+
+    case PICK_CAPTURES_GEN:
+        mp->count = movegen_qs(mp->moves);
+        movepicker_addKeys(mp, 0);
+        mp->stage = PICK_CAPTURES;
+        // fall through
+
+    case PICK_CAPTURES:
+
+        /* good captures and promotions; bad captures wait for the quiet moves */
+
+        while (mp->current < mp->count) {
+            int best = movepicker_best(mp);
+            if (PICK_SCORE(mp->keys[mp->current]) < SORT_KILL) break;
+
+            mp->current++;
+            *move = mp->moves[best];
+            if (move_encode(*move) != mp->hash_move) {
+                mp->see = PICK_SEE(mp->keys[mp->current - 1]);
+                return 1;
+            }
+        }
+        mp->stage = PICK_KILLER_1;
+        // fall through
+
+    case PICK_KILLER_1:
+    case PICK_KILLER_2:
+
+        /**********************************************************************
+        *  Killers come from sibling nodes, so they must be validated in the  *
+        *  current position. Killers that are captures here have already      *
+        *  been tried among the captures.                                     *
+        **********************************************************************/
+
+        while (mp->stage <= PICK_KILLER_2) {
+            int k = mp->stage - PICK_KILLER_1;
+            U32 code = move_encode(sd.killers[mp->ply][k]);
+            mp->stage++;
+
+            if (code == mp->hash_move || code == mp->killer[0]) continue;
+            if (!movegen_decode(code, move)) continue;
+            if (move_iscapt(*move) || move_isprom(*move)) continue;
+
+            mp->killer[k] = code;
+            return 1;
+        }
+        // fall through
+
+    case PICK_QUIETS_GEN: {
+        int first = mp->count;
+        mp->count += movegen_quiet(mp->moves + first);
+        movepicker_addKeys(mp, first);
+        mp->stage = PICK_QUIETS;
+    }
+        // fall through
+
+    case PICK_QUIETS:
+        while (mp->current < mp->count) {
+            *move = mp->moves[movepicker_best(mp)];
+            mp->current++;
+
+            U32 code = move_encode(*move);
+            if (code != mp->hash_move && code != mp->killer[0] && code != mp->killer[1]) {
+                mp->see = PICK_SEE(mp->keys[mp->current - 1]);
+                return 1;
+            }
+        }
+        mp->stage = PICK_DONE;
+        break;
+
+    case PICK_EVASION_HASH:
+        mp->stage = PICK_EVASIONS_GEN;
+        if (mp->hash_move != NO_MOVE) {
+            *move = mp->hash;
+            return 1;
+        }
+        // fall through
+
+    case PICK_EVASIONS_GEN:
+        mp->count = movegen_evasions(mp->moves);
+        movepicker_addKeys(mp, 0);
+        mp->stage = PICK_EVASIONS;
+        // fall through
+
+    case PICK_EVASIONS:
+        while (mp->current < mp->count) {
+            *move = mp->moves[movepicker_best(mp)];
+            mp->current++;
+            if (move_encode(*move) != mp->hash_move) {
+                mp->see = PICK_SEE(mp->keys[mp->current - 1]);
+                return 1;
+            }
+        }
+        mp->stage = PICK_DONE;
+        break;
+
+    case PICK_QS_CAPTURES:
+        for (;;) {
+            if (mp->current < mp->count) {
+                *move = mp->moves[movepicker_best(mp)];
+                mp->see = PICK_SEE(mp->keys[mp->current]);
+                mp->current++;
+                return 1;
+            }
+            if (mp->victim == NUM_TYPES) break;
+
+            /* on to the next most valuable type of victim */
+            int first = mp->count;
+            mp->count += movegen_captures(mp->moves + first, e.VICTIM_ORDER[mp->victim++]);
+            movepicker_addKeys(mp, first);
+        }
+        mp->stage = PICK_QS_PROMOTIONS_GEN;
+        // fall through
+
+    case PICK_QS_PROMOTIONS_GEN: {
+        int first = mp->count;
+        mp->count += movegen_promotions(mp->moves + first);
+        movepicker_addKeys(mp, first);
+        mp->stage = PICK_QS_PROMOTIONS;
+    }
+        // fall through
+
+    case PICK_QS_PROMOTIONS:
+        if (mp->current < mp->count) {
+            *move = mp->moves[movepicker_best(mp)];
+            mp->see = PICK_SEE(mp->keys[mp->current]);
+            mp->current++;
+            return 1;
+        }
+        mp->stage = PICK_DONE;
+        break;
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+*  Whether the move handed out last wins at least "margin" by static exchange *
+*  evaluation. A capture that broke even when it was scored also passes any   *
+*  lower margin, and one that lost fails any higher margin, so the verdict    *
+*  from its sort key answers most questions without a second exchange.        *
+******************************************************************************/
+
+int movepicker_seeGe(smovepicker * mp, smove move, int margin) {
+    if (mp->see == SEE_GOOD && margin <= 0) return 1;
+    if (mp->see == SEE_BAD && margin >= 0) return 0;
+    return see_ge(move, margin);
+}
+
+void movegen_sort(U8 movecount, smove * m, int * scores, U8 current) {
 
     //find the move with the highest score - hoping for an early cutoff
 
     int high = current;
 
     for (int i=current+1; i<movecount; i++) {
-        if (m[i].score > m[high].score)
+        if (scores[i] > scores[high])
             high = i;
     }
 
     smove temp = m[high];
     m[high] = m[current];
     m[current] = temp;
+
+    int score = scores[high];
+    scores[high] = scores[current];
+    scores[current] = score;
 }
@@ -5,6 +5,49 @@
 *   other members of the Chess Programming Wiki.
 */
 
+/* which moves movegen_pieces() and movegen_pawn_move() produce */
+enum egenkind {
+    GEN_ALL,
+    GEN_NOISY,   // captures and promotions
+    GEN_QUIET    // everything else, castling included
+};
+
+/* stages of the move picker */
+enum epickstage {
+    PICK_HASH,
+    PICK_CAPTURES_GEN,
+    PICK_CAPTURES,
+    PICK_KILLER_1,
+    PICK_KILLER_2,
+    PICK_QUIETS_GEN,
+    PICK_QUIETS,
+    PICK_EVASION_HASH,  // in check: the hash move, then all evasions
+    PICK_EVASIONS_GEN,
+    PICK_EVASIONS,
+    PICK_QS_CAPTURES,   // quiescence search: captures, by falling victim value
+    PICK_QS_PROMOTIONS_GEN,
+    PICK_QS_PROMOTIONS,
+    PICK_DONE
+};
+
+/******************************************************************************
+*  Sort key of a move: higher score first, equal scores in generation order.  *
+*  The two lowest bits keep the SEE verdict of a capture (see esee), so that  *
+*  the search need not run the exchange evaluation a second time.             *
+******************************************************************************/
+
+#define PICK_KEY(score, see, index) ( (S64) (score) * 1024 + (255 - (index)) * 4 + (see) )
+#define PICK_INDEX(key)             ( 255 - (int) (((key) >> 2) & 255) )
+#define PICK_SEE(key)               ( (U8) ((key) & 3) )
+#define PICK_SCORE(key)             ( (int) ((key) >> 10) )
+
+/* picks made by scanning before the rest of a stage is sorted */
+#define PICK_SCANS 3
+
+void movepicker_addKeys(smovepicker * mp, int first);
+int movepicker_best(smovepicker * mp);
+void movegen_castling();
+void movegen_pieces(U8 kind);
 void movegen_push(U8 from, U8 to, U8 piece_from, U8 piece_cap, char flags);
-void movegen_pawn_move(U8 sq, bool promotion_only);
+void movegen_pawn_move(U8 sq, U8 kind);
 void movegen_pawn_capt(U8 sq);
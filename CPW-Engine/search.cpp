@@ -8,6 +8,8 @@
 #include "stdafx.h"
 #include "search.h"
 #include "transposition.h"
+#include <thread>
+#include <cmath>
 
 
 /* symbols used to enhance readability */
@@ -16,13 +18,19 @@
 #define IS_PV      1
 #define NO_PV      0
 
-sSearchDriver sd;
+sSearchDriver drivers[MAX_THREADS];
+THREAD_PTR sSearchDriver * driver_ptr = &drivers[0];
 
 int draw_opening = -10; // middlegame draw value
 int draw_endgame = 0;   // endgame draw value
 int ASPIRATION = 50;  // size of the aspiration window ( val-ASPITATION, val+ASPIRATION )
 
-bool time_over = 0;
+/* late move reductions: base + log(depth) * log(moves) / divisor, in 1/100 ply */
+int LMR_BASE = 75;
+int LMR_DIVISOR = 225;
+U8 lmr_table[64][64];
+
+std::atomic<bool> time_over(false);
 
 enum eproto {
 	PROTO_NOTHING,
@@ -32,8 +40,14 @@ enum eproto {
 
 extern eproto mode;
 
-U8 bestmove;         // move id passed between iterations for sorting purposes
-smove move_to_make;	 // move to be returned when search runs out of time
+thread_local U32 bestmove;        // move code passed between iterations for sorting purposes
+thread_local smove move_to_make;	 // move to be returned when search runs out of time
+
+/* Lazy SMP helper threads, see search_startHelpers() */
+std::thread helper_thread[MAX_THREADS];
+std::atomic<U64> helper_nodes[MAX_THREADS]; // published by the helpers, see CheckInput()
+int helper_count = 0;
+sboard root_board;
 
 /******************************************************************************
 *  search_run() is the only function called outside search.cpp, so it acts as *
@@ -49,8 +63,10 @@ void search_run() {
 	search_clearDriver();
 	time_calc_movetime();
 	ageHistoryTable();
+	tt_newSearch();
 	if (mode == PROTO_NOTHING) printSearchHeader();
 
+	search_startHelpers();
 	search_iterate();
 }
 
@@ -59,12 +75,29 @@ void search_clearDriver() {
 	sd.starttime = gettime();
 	sd.movetime = 0;
 	sd.depth = 0;
+	sd.pv_length[0] = 0;
 
 	// now clear all the statistical data
 	sd.nodes = 0;
 	sd.q_nodes = 0;
 }
 
+/******************************************************************************
+*  Late move reductions are looked up in a table indexed by remaining depth   *
+*  and move count. Both grow slowly, so we use the product of logarithms,     *
+*  with a base and a divisor that can be set in cpw.ini. This must be called  *
+*  after the ini file has been read.                                          *
+******************************************************************************/
+
+void search_initReductions() {
+	for (int depth = 0; depth < 64; depth++)
+		for (int moves = 0; moves < 64; moves++) {
+			if (!depth || !moves) { lmr_table[depth][moves] = 0; continue; }
+			double r = LMR_BASE / 100.0 + log(depth) * log(moves) / (LMR_DIVISOR / 100.0);
+			lmr_table[depth][moves] = r > 0 ? (U8) r : 0;
+		}
+}
+
 /******************************************************************************
 *  search_iterate() calls search_root() with increasing depth until allocated *
 *  time is exhausted.                                                         *
@@ -94,8 +127,70 @@ void search_iterate() {
 		val = search_widen(sd.depth, val);
 	}
 
-	// after the loop has finished, send the move to the interface
-	com_sendmove(move_to_make);
+	// the helper threads must be stopped before we touch the board again
+	search_stopHelpers();
+
+	// after the loop has finished, send the move to the interface,
+	// together with the reply we expect, if the PV has one
+	com_sendmove(move_to_make, sd.pv_length[0] > 1 ? &sd.pv[0][1] : NULL);
+}
+
+/******************************************************************************
+*  Lazy SMP. Helper threads run their own iterative deepening loop on a copy  *
+*  of the root position, with their own history, killers and node counters.   *
+*  The only thing they share with the main thread is the transposition table, *
+*  so whatever they find reaches the main thread as hash moves and cutoffs.   *
+*  Every other helper starts one ply deeper, so that the threads do not walk  *
+*  the same tree in lockstep. Only the main thread reads input, keeps track   *
+*  of time and reports its result to the interface. Node counters belong to  *
+*  their threads, so the helpers publish a copy of theirs every 1024 nodes,   *
+*  which is what the main thread adds up in search_nodes().                   *
+******************************************************************************/
+
+void search_startHelpers() {
+	root_board = b;
+	helper_count = options.threads;
+
+	for (int id = 1; id < helper_count; id++) {
+		helper_nodes[id].store(0, std::memory_order_relaxed);
+		helper_thread[id] = std::thread(search_helper, id);
+	}
+}
+
+void search_helper(int id) {
+	board_ptr = &boards[id];
+	driver_ptr = &drivers[id];
+
+	b = root_board;
+	clearHistoryTable();
+	search_clearDriver();
+	sd.thread_id = id;
+
+	sd.depth = 1;
+	int val = search_root(sd.depth, -INF, INF);
+
+	for (sd.depth = 2 + (id & 1); sd.depth <= MAX_DEPTH && !time_over; sd.depth += 1)
+		val = search_widen(sd.depth, val);
+
+	helper_nodes[id].store(sd.nodes, std::memory_order_relaxed);
+}
+
+void search_stopHelpers() {
+	if (helper_count < 2) return;
+
+	time_over = true;
+	for (int id = 1; id < helper_count; id++)
+		helper_thread[id].join();
+}
+
+/* total number of nodes searched by all the threads */
+U64 search_nodes() {
+	U64 nodes = sd.nodes;
+
+	for (int id = 1; id < helper_count; id++)
+		nodes += helper_nodes[id].load(std::memory_order_relaxed);
+
+	return nodes;
 }
 
 int search_widen(int depth, int val) {
@@ -113,6 +208,7 @@ int search_root(U8 depth, int alpha, int beta) {
 
 	int flagInCheck;
 	smove movelist[256];
+	int scores[256];
 	int val = 0;
 	int best = -INF;
 
@@ -122,25 +218,29 @@ int search_root(U8 depth, int alpha, int beta) {
 	flagInCheck = isAttacked(!b.stm, b.king_loc[b.stm]);
 	if (flagInCheck) ++depth;
 
-	U8 mcount = movegen(movelist, bestmove);
+	spins pins;
+	movegen_pins(&pins);
+
+	U8 mcount = movegen(movelist);
+
+	/* the best move of the previous iteration goes first */
+	for (U8 i = 0; i < mcount; i++)
+		scores[i] = move_encode(movelist[i]) == bestmove ? SORT_HASH : movegen_score(movelist[i], NULL);
 
 	for (U8 i = 0; i < mcount; i++) {
 
 		int cl = b.stm;
-		movegen_sort(mcount, movelist, i);
+		movegen_sort(mcount, movelist, scores, i);
 
 		if (movelist[i].piece_cap == KING) {
 			alpha = INF;
-			bestmove = movelist[i].id;
+			bestmove = move_encode(movelist[i]);
 		}
 
-		move_make(movelist[i]);
-
 		// filter out illegal moves
-		if (isAttacked(b.stm, b.king_loc[!b.stm])) {
-			move_unmake(movelist[i]);
-			continue;
-		}
+		if (!movegen_isLegal(&pins, movelist[i])) continue;
+
+		move_make(movelist[i]);
 
 		sd.cutoff[cl] [movelist[i].from][movelist[i].to] -= 1;
 
@@ -164,8 +264,9 @@ int search_root(U8 depth, int alpha, int beta) {
 
 		if (val > alpha) {
 
-			bestmove = movelist[i].id;
+			bestmove = move_encode(movelist[i]);
 			move_to_make = movelist[i];
+			pv_update(0, movelist[i]);
 
 			if (val > beta) {
 				tt_save(depth, beta, TT_BETA, bestmove);
@@ -187,8 +288,8 @@ int search_root(U8 depth, int alpha, int beta) {
 int Search(U8 depth, U8 ply, int alpha, int beta, int can_null, int is_pv) {
 
 	int  val = -INF;
-	char bestmove;
-	char tt_move_index = (char)-1;
+	U32  bestmove;
+	U32  tt_move = NO_MOVE;
 	char tt_flag = TT_ALPHA;
 	int  flagInCheck;
 	int  raised_alpha = 0;
@@ -197,9 +298,12 @@ int Search(U8 depth, U8 ply, int alpha, int beta, int can_null, int is_pv) {
 	int  moves_tried = 0;
 	int  new_depth;
 	int  mate_value = INF - ply; // will be used in mate distance pruning
-	smove movelist[256];         // move list
+	int  singular = 0;           // is the hash move the only good one?
+	U32  excluded = sd.excluded[ply]; // set when called by singular search
 	smove move;                  // current move
 
+	/* nothing has been found below this node yet, see pv_update() */
+	if (ply + 1 < MAX_PLY) sd.pv_length[ply + 1] = 0;
 
 	/**************************************************************************
 	*  Probably later we will want to probe the transposition table. Here we  *
@@ -207,7 +311,7 @@ int Search(U8 depth, U8 ply, int alpha, int beta, int can_null, int is_pv) {
 	*  optimization and program would run fine without that.                  *
 	**************************************************************************/
 
-	_mm_prefetch((char *)&tt[b.hash & tt_size], _MM_HINT_NTA);
+	_mm_prefetch((char *)&tt[tt_index(b.hash, tt_size)], _MM_HINT_NTA);
 
 	/**************************************************************************
 	* Check for timeout. This is quite time-consuming, so we do it only every *
@@ -254,16 +358,16 @@ int Search(U8 depth, U8 ply, int alpha, int beta, int can_null, int is_pv) {
 	*  Read the transposition table. We may have already searched current     *
 	*  position. If depth was sufficient, then we might use the score         *
 	*  of that search. If not, hash move still is expected to be good         *
-	*  and should be sorted first.                                            *
-	*                                                                         *
-	*  NOTE: current implementation is sub-standard, since tt_move is just    *
-	*  an index showing move's location on a move list. We should be able     *
-	*  to retrieve move without generating full move list instead.            *
+	*  and should be sorted first. The hash move is stored as a move code,    *
+	*  which may come from a different position if two hash keys collide,    *
+	*  so it is used only if it is pseudo-legal here.                         *
+	*  In PV nodes we never return the hash score, because the table holds    *
+	*  no line to go with it and the reported PV would be cut short. Neither  *
+	*  do we in the singular search, which leaves out one of the moves.       *
 	**************************************************************************/
 
-	if ((val = tt_probe(depth, alpha, beta, &tt_move_index)) != INVALID) {
-		// in pv nodes we return only in case of an exact hash hit
-		if (!is_pv || (val > alpha && val < beta)) {
+	if ((val = tt_probe(depth, alpha, beta, &tt_move)) != INVALID) {
+		if (!is_pv && !excluded) {
 
 			/******************************************************************
 			*  Here we must be careful about checkmate scoring. "Mate in n"   *
@@ -283,8 +387,16 @@ int Search(U8 depth, U8 ply, int alpha, int beta, int can_null, int is_pv) {
 		}
 	}
 
+	smove hash_move;
+	if (!movegen_decode(tt_move, &hash_move))
+		tt_move = NO_MOVE;
+
 	int static_eval = eval(alpha, beta, 1);
 
+	/* is our position better than it was two plies ago? used by LMR */
+	sd.static_eval[ply] = static_eval;
+	int improving = !flagInCheck && (ply < 2 || static_eval > sd.static_eval[ply - 2]);
+
 	/**************************************************************************
 	* EVAL PRUNING / STATIC NULL MOVE                                         *
 	**************************************************************************/
@@ -316,6 +428,7 @@ int Search(U8 depth, U8 ply, int alpha, int beta, int can_null, int is_pv) {
 	if (depth > 2
 		&&   can_null
 		&&  !is_pv
+		&&  !excluded
 		&&   static_eval + 200 > beta
 		&&   b.piece_material[b.stm] > e.ENDGAME_MAT
 		&&   beta < INF - 100 && beta > -INF + 100
@@ -355,7 +468,7 @@ int Search(U8 depth, U8 ply, int alpha, int beta, int can_null, int is_pv) {
 
 	if (!is_pv
 	&&  !flagInCheck
-	&&  tt_move_index == -1
+	&&  tt_move == NO_MOVE
 	&&  can_null
 	&&  depth <= 3) {
 		int threshold = alpha - 300 - (depth - 1) * 60;
@@ -382,30 +495,74 @@ int Search(U8 depth, U8 ply, int alpha, int beta, int can_null, int is_pv) {
 		 f_prune = 1;
 
 	/**************************************************************************
-	*  Generate moves, then place special cases higher on the list            *
+	*  SINGULAR EXTENSION. If the hash move comes from a deep enough search   *
+	*  and is not just an upper bound, we search all the other moves to half  *
+	*  depth against a bound somewhat below its value. If they all fail low,  *
+	*  the hash move is the only good move here, so it is searched one ply    *
+	*  deeper - but only if its entry is at least as deep as this node, as a  *
+	*  shallower value is not worth the cost of a deeper subtree. If instead  *
+	*  the rest of the moves beat beta as well, there are several refutations *
+	*  and we cut off the whole node (multi-cut). Every extension makes the   *
+	*  whole subtree deeper, so we stop extending once the line is already    *
+	*  longer than the nominal depth of the iteration. A singular search cut  *
+	*  short by the clock proves nothing, so we leave before using its value. *
 	**************************************************************************/
 
-	U8 mcount = movegen(movelist, tt_move_index);
-	ReorderMoves(movelist, mcount, ply);
-	bestmove = movelist[0].id;
+	int tt_val;
+	U8  tt_depth;
+	char tt_bound;
+
+	if (depth >= 8
+	&&   tt_move != NO_MOVE
+	&&  !excluded
+	&&   ply + depth <= sd.depth
+	&&   tt_probeEntry(&tt_val, &tt_depth, &tt_bound)
+	&&   tt_bound != TT_ALPHA
+	&&   tt_depth >= depth - 3
+	&&   abs(tt_val) < 9000) {
+		int singular_beta = tt_val - 2 * depth;
+
+		sd.excluded[ply] = tt_move;
+		val = Search((depth - 1) / 2, ply, singular_beta - 1, singular_beta, NO_NULL, NO_PV);
+		sd.excluded[ply] = NO_MOVE;
+
+		if (time_over) return 0;
+
+		if (val < singular_beta)
+			singular = tt_depth >= depth;
+		else if (singular_beta >= beta && !is_pv)
+			return singular_beta;
+	}
 
 	/**************************************************************************
-	*  Loop through the move list, trying them one by one.                    *
+	*  Loop through the moves, trying them one by one. The move picker        *
+	*  generates them in stages, best candidates first - see movegen.cpp.     *
+	*  In check it generates only the moves that may answer the check.        *
+	*  The pins are found once, so illegal moves are skipped without making   *
+	*  them, and so are the checks each move could give. If no move raises    *
+	*  alpha, we keep the old hash move in the table.                         *
 	**************************************************************************/
 
-	for (int i = 0; i < mcount; i++) {
+	spins pins;
+	movegen_pins(&pins);
 
-		int cl = b.stm;
-		movegen_sort(mcount, movelist, i); // pick the best of untried moves
-		move = movelist[i];
-		move_make(move);
+	schecks checks;
+	movegen_checks(&checks);
 
-		// filter out illegal moves
-		if (isAttacked(b.stm, b.king_loc[!b.stm])) {
-			move_unmake(move);
-			continue;
-		}
+	smovepicker mp;
+	if (flagInCheck)
+		movepicker_initEvasions(&mp, tt_move != NO_MOVE ? &hash_move : NULL, ply);
+	else
+		movepicker_init(&mp, tt_move != NO_MOVE ? &hash_move : NULL, ply);
+	bestmove = tt_move;
+
+	while (movepicker_next(&mp, &move)) {
+
+		// filter out illegal moves, and the move left out by singular search
+		if (!movegen_isLegal(&pins, move)) continue;
+		if (excluded && move_encode(move) == excluded) continue;
 
+		int givesCheck = movegen_givesCheck(&checks, move);
 
 		/**********************************************************************
 		*  When the futility pruning flag is set, prune moves which do not    *
@@ -417,15 +574,34 @@ int Search(U8 depth, U8 ply, int alpha, int beta, int can_null, int is_pv) {
 		&&   moves_tried
 		&&  !move_iscapt(move)
 		&&  !move_isprom(move)
-		&&  !isAttacked(!b.stm, b.king_loc[b.stm])) {
-			move_unmake(move);
+		&&  !givesCheck)
 			continue;
-		}
+
+		/**********************************************************************
+		*  SEE pruning. Close to the leaves, a move that loses material by    *
+		*  static exchange evaluation is not searched, unless the loss is     *
+		*  small compared to the remaining depth. Captures are allowed to     *
+		*  lose more than quiet moves, because they also remove a defender.   *
+		**********************************************************************/
+
+		if (!is_pv
+		&&  !flagInCheck
+		&&   moves_tried
+		&&   depth <= 6
+		&&   abs(alpha) < 9000
+		&&  !givesCheck
+		&&  !move_isprom(move)
+		&&  !movepicker_seeGe(&mp, move, move_iscapt(move) ? -100 * depth : -50 * depth))
+			continue;
+
+		int cl = b.stm;
+		move_make(move);
 
 		sd.cutoff[cl][move.from][move.to] -= 1;
 		moves_tried++;
 		reduction_depth = 0;       // this move has not been reduced yet
 		new_depth = depth - 1;     // decrease depth by one ply
+		if (singular && move_encode(move) == tt_move) new_depth += 1;
 
 		/**********************************************************************
 		*  Late move reduction. Typically a cutoff occurs on trying one of    *
@@ -437,10 +613,9 @@ int Search(U8 depth, U8 ply, int alpha, int beta, int can_null, int is_pv) {
 		*  filter out tactical moves that may cause a late cutoff.            *
 		**********************************************************************/
 
-		if (!is_pv
-		&& new_depth > 1 // was 3
+		if (new_depth > 1
 		&& moves_tried > 3
-		&& !isAttacked(!b.stm, b.king_loc[b.stm])
+		&& !givesCheck
 		&& !flagInCheck
 		&& !nullMoveMatesUs
 		&&  sd.cutoff[cl][move.from][move.to] < 50
@@ -450,17 +625,24 @@ int Search(U8 depth, U8 ply, int alpha, int beta, int can_null, int is_pv) {
 		&& !move_isprom(move)) {
 
 			/******************************************************************
-			* Real programs tend to use more advanced formulas to calculate   *
-			* reduction depth. Typically they calculate it from both remai-   *
-			* ning depth and move count. Formula used here is very basic and  *
-			* gives only a minimal improvement over uniform one ply reduction,*
-			* and is included for the sake of completeness only.              *
+			* Reduction depth grows with both remaining depth and move count, *
+			* see search_initReductions(). We reduce one ply less in PV nodes *
+			* and for moves with a good history score, and one ply more if    *
+			* our position is not improving. Reduced search never goes        *
+			* straight to quiescence.                                         *
 			******************************************************************/
 
-			sd.cutoff[cl][move.from][move.to] = 50;
-			reduction_depth = 1;
-			if ((new_depth > 3 && moves_tried > 6) || (new_depth > 2 && moves_tried > 10)) reduction_depth += 1;
-			new_depth -= reduction_depth;
+			reduction_depth = lmr_table[depth < 64 ? depth : 63][moves_tried < 64 ? moves_tried : 63];
+			if (is_pv) reduction_depth -= 1;
+			if (!improving) reduction_depth += 1;
+			if (sd.history[cl][move.from][move.to] > 4 * depth * depth) reduction_depth -= 1;
+
+			if (reduction_depth > new_depth - 1) reduction_depth = new_depth - 1;
+			if (reduction_depth > 0) {
+				sd.cutoff[cl][move.from][move.to] = 50;
+				new_depth -= reduction_depth;
+			}
+			else reduction_depth = 0;
 		}
 
 	    re_search:
@@ -484,7 +666,8 @@ int Search(U8 depth, U8 ply, int alpha, int beta, int can_null, int is_pv) {
 			val = -Search(new_depth, ply + 1, -beta, -alpha, DO_NULL, is_pv);
 		else {
 			// first try to refute a move - if this fails, do a real search
-			if (-Search(new_depth, ply + 1, -alpha - 1, -alpha, DO_NULL, NO_PV) > alpha)
+			val = -Search(new_depth, ply + 1, -alpha - 1, -alpha, DO_NULL, NO_PV);
+			if (val > alpha)
 				val = -Search(new_depth, ply + 1, -beta, -alpha, DO_NULL, IS_PV);
 		}
 
@@ -514,8 +697,9 @@ int Search(U8 depth, U8 ply, int alpha, int beta, int can_null, int is_pv) {
 
 		if (val > alpha) {
 
-			bestmove = movelist[i].id;
+			bestmove = move_encode(move);
 			sd.cutoff[cl][move.from][move.to] += 6;
+			if (is_pv) pv_update(ply + 1, move);
 
 			if (val >= beta) {
 
@@ -527,7 +711,7 @@ int Search(U8 depth, U8 ply, int alpha, int beta, int can_null, int is_pv) {
 
 				if (!move_iscapt(move)
 				&& !move_isprom(move)) {
-					setKillers(movelist[i], ply);
+					setKillers(move, ply);
 					sd.history[b.stm][move.from][move.to] += depth*depth;
 
 					/**********************************************************
@@ -537,9 +721,9 @@ int Search(U8 depth, U8 ply, int alpha, int beta, int can_null, int is_pv) {
 
 					if (sd.history[b.stm][move.from][move.to] > SORT_KILL) {
 						for (int cl = 0; cl < NUM_PLAYERS; cl++)
-							for (int a = 0; a < NUM_SQUARES; a++)
-								for (int b = 0; b < NUM_SQUARES; b++) {
-									sd.history[cl][a][b] = sd.history[cl][a][b] / 2;
+							for (int from = 0; from < NUM_SQUARES; from++)
+								for (int to = 0; to < NUM_SQUARES; to++) {
+									sd.history[cl][from][to] = sd.history[cl][from][to] / 2;
 								}
 					}
 				}
@@ -564,18 +748,39 @@ int Search(U8 depth, U8 ply, int alpha, int beta, int can_null, int is_pv) {
 	**************************************************************************/
 
 	if (!moves_tried) {
-		bestmove = -1;
+		bestmove = NO_MOVE;
 
-		if (flagInCheck) alpha = -INF + ply;
-		else             alpha = contempt();
+		// without the excluded move the node proves nothing, so it fails low
+		if (excluded)         return alpha;
+		else if (flagInCheck) alpha = -INF + ply;
+		else                  alpha = contempt();
 	}
 
+	/* the singular search leaves out a move, so its result is not saved */
+	if (excluded) return alpha;
+
 	/* tt_save() does not save anything when the search is timed out */
 	tt_save(depth, alpha, tt_flag, bestmove);
 
 	return alpha;
 }
 
+/******************************************************************************
+*  The principal variation is collected in a triangular table. Each row holds *
+*  the best line found below one node: when a move raises alpha, the row is   *
+*  rewritten as that move followed by the row of the node below. The root    *
+*  owns row 0. search_root() calls Search() with ply 0, so a node at ply n    *
+*  owns row n + 1, and clears it on entry.                                    *
+******************************************************************************/
+
+void pv_update(U8 row, smove move) {
+	if (row + 1 >= MAX_PLY) return;
+
+	sd.pv[row][0] = move;
+	memcpy(&sd.pv[row][1], sd.pv[row + 1], sd.pv_length[row + 1] * sizeof(smove));
+	sd.pv_length[row] = sd.pv_length[row + 1] + 1;
+}
+
 void setKillers(smove m, U8 ply) {
 
 	/* if a move isn't a capture, save it as a killer move */
@@ -592,25 +797,10 @@ void setKillers(smove m, U8 ply) {
 	}
 }
 
-void ReorderMoves(smove * m, U8 mcount, U8 ply) {
-
-	for (int j = 0; j<mcount; j++) {
-		if ((m[j].from == sd.killers[ply][1].from)
-		&& (m[j].to == sd.killers[ply][1].to)
-		&& (m[j].score < SORT_KILL - 1)) {
-			m[j].score = SORT_KILL - 1;
-		}
-
-		if ((m[j].from == sd.killers[ply][0].from)
-		&& (m[j].to == sd.killers[ply][0].to)
-		&& (m[j].score < SORT_KILL)) {
-			m[j].score = SORT_KILL;
-		}
-	}
-}
-
 int info_currmove(smove m, int nr) {
 
+	if (sd.thread_id) return 0; // only the main thread talks to the interface
+
 	switch (mode) {
 	case PROTO_UCI:
 
@@ -630,6 +820,8 @@ int info_pv(int val) {
 	char score[10];
 	char pv[2048];
 
+	if (sd.thread_id) return 0; // only the main thread talks to the interface
+
 	if (abs(val) < INF - 2000) {
 		sprintf(score, "cp %d", val);
 	}
@@ -639,7 +831,7 @@ int info_pv(int val) {
 		else         sprintf(score, "mate %d", -(INF + val) / 2 - 1);
 	}
 
-	U32 nodes = (U32)sd.nodes;
+	U32 nodes = (U32)search_nodes();
 	U32 time = gettime() - sd.starttime;
 
 	util_pv(pv);
@@ -730,6 +922,13 @@ int contempt() {
 
 void CheckInput() {
 
+	// helper threads never read input, the main thread stops them via time_over
+	if (sd.thread_id) {
+		if (!(sd.nodes & 1023))
+			helper_nodes[sd.thread_id].store(sd.nodes, std::memory_order_relaxed);
+		return;
+	}
+
 	if (!time_over && !(sd.nodes & 4095))
 		time_over = time_stop();
 }
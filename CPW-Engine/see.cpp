@@ -10,35 +10,91 @@
 
 
 /******************************************************************************
-*  This is not yet proper static exchange evaluation, but an approximation    *
-*  proposed by Harm Geert Mueller under the acronym BLIND (better, or lower   *
-*  if not defended. As the name indicates, it detects only obviously good     *
-*  captures, but it seems enough to improve move ordering.                    *
+*  Static exchange evaluation: the material a capture wins or loses if both   *
+*  sides keep recapturing on the target square, always with their least       *
+*  valuable piece, and either side may stop when going on would cost it.     *
+*                                                                             *
+*  The gains are collected in a swap list, then minimaxed from the end. Each  *
+*  time a piece leaves for the target square, the sliders behind it are       *
+*  looked up again, so x-ray attackers join in. Compound pieces count with    *
+*  their knight jumps as well, see attackersOf(). A king joins in only as the *
+*  last capturer. Pins and promotions are ignored.                            *
 ******************************************************************************/
 
-int Blind (smove move) {
-	int sq_to = move.to;
-	int sq_fr = move.from;
-	int pc_fr = b.pieces[sq_fr];
-	int pc_to = b.pieces[sq_to];
-	int val = e.SORT_VALUE[pc_to];
-
-	/* captures by pawn do not lose material */
-	if (pc_fr == PAWN) return 1;
-
-	/* Captures "lower takes higher" (as well as BxN) are good by definition. */
-	if (e.SORT_VALUE[pc_to] >= e.SORT_VALUE[pc_fr] - 50)
-		return 1;
-
-	/* Make the first capture, so that X-ray defender shows up*/
-	clearSq(sq_fr);
-
-	/* Captures of undefended pieces are good by definition */
-	if (!isAttacked(!b.stm, sq_to)) {
-		fillSq(b.stm, pc_fr, sq_fr);
-		return 1;
-	}
-	
-	fillSq(b.stm, pc_fr, sq_fr);
-	return 0; // of other captures we know nothing, Jon Snow!
+/* the least valuable piece of a set of attackers, PIECE_EMPTY if there is none */
+static U8 leastValuable(sbitboard attackers, U8 * from) {
+    for (int i = NUM_TYPES - 1; i >= 0; i--) {
+        sbitboard set = attackers & b.bb_type[e.VICTIM_ORDER[i]];
+        if (bb_any(set)) {
+            *from = BB_SQUARE(bb_lsb(set));
+            return e.VICTIM_ORDER[i];
+        }
+    }
+    return PIECE_EMPTY;
+}
+
+int see(smove move) {
+
+    int gain[40];
+    int depth = 0;
+    U8 sq = move.to;
+    U8 side = b.color[move.from];
+    U8 onSquare = move.piece_from;   // the piece that will be taken next
+
+    sbitboard occ = (b.bb_color[WHITE] | b.bb_color[BLACK]) ^ bb_square(move.from);
+
+    if (move.flags & MFLAG_EPCAPTURE) {
+        gain[0] = e.PIECE_VALUE[PAWN];
+        occ ^= bb_square(side == WHITE ? sq + SOUTH : sq + NORTH);
+    }
+    else
+        gain[0] = move.piece_cap == PIECE_EMPTY ? 0 : e.PIECE_VALUE[move.piece_cap];
+
+    sbitboard straight = b.bb_type[ROOK] | b.bb_type[QUEEN] | b.bb_type[CHANCELLOR];
+    sbitboard diagonal = b.bb_type[BISHOP] | b.bb_type[QUEEN] | b.bb_type[ARCHBISHOP];
+    sbitboard attackers = attackersOf(sq, occ) & occ;
+
+    for (;;) {
+        side = !side;
+
+        U8 from;
+        U8 piece = leastValuable(attackers & b.bb_color[side], &from);
+        if (piece == PIECE_EMPTY) break;
+
+        /* the king cannot take a defended piece */
+        if (piece == KING && bb_any(attackers & b.bb_color[!side])) break;
+
+        depth++;
+        gain[depth] = e.PIECE_VALUE[onSquare] - gain[depth - 1];
+        onSquare = piece;
+
+        /* the capturer leaves its square, uncovering the sliders behind it */
+        occ ^= bb_square(from);
+        attackers = attackers | (bb_rookAttacks(sq, occ) & straight)
+                              | (bb_bishopAttacks(sq, occ) & diagonal);
+        attackers = attackers & occ;
+    }
+
+    /* either side may refuse to recapture */
+    while (depth > 0) {
+        if (-gain[depth] < gain[depth - 1]) gain[depth - 1] = -gain[depth];
+        depth--;
+    }
+
+    return gain[0];
+}
+
+/* does the capture win at least margin? Usually decided without the swap list */
+int see_ge(smove move, int margin) {
+
+    int captured = (move.flags & MFLAG_EPCAPTURE) ? e.PIECE_VALUE[PAWN]
+                 : (move.piece_cap == PIECE_EMPTY ? 0 : e.PIECE_VALUE[move.piece_cap]);
+
+    /* the opponent can always stop recapturing, so we win at most the victim */
+    if (captured < margin) return 0;
+
+    /* and we can stop too, losing at most the capturing piece */
+    if (captured - e.PIECE_VALUE[move.piece_from] >= margin) return 1;
+
+    return see(move) >= margin;
 }
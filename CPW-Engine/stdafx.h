@@ -13,10 +13,20 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <atomic>
 
 #define INF 10000
 #define INVALID 32767
 #define MAX_DEPTH 100
+#define MAX_PLY 128
+#define MAX_THREADS 64
+
+/* a thread-local pointer with a constant initializer, see "b" below */
+#ifdef _MSC_VER
+#define THREAD_PTR __declspec(thread)
+#else
+#define THREAD_PTR __thread
+#endif
 
 #ifdef __linux__
 typedef unsigned char U8;
@@ -56,6 +66,11 @@ typedef long long S64;
 #define BOOK_NARROW 1
 #define BOOK_BROAD 2
 
+/* keep per-square attack counters on the board, so that isAttacked() is a
+   lookup. Updating them in fillSq()/clearSq() costs more than the lookups
+   save in the current search, so this is off by default. */
+// #define ATTACK_MAPS
+
 #define NUM_TYPES 8
 #define NUM_SQUARES 160
 #define NUM_FILES 10
@@ -111,9 +126,32 @@ enum emflag {
     MFLAG_NULLMOVE = 32
 };
 
+#include "bitboard.h"
+
+/******************************************************************************
+*  The board state before a move, saved by move_make(). Besides what the move *
+*  itself cannot tell us (castling rights, en passant square, fifty move      *
+*  counter) it holds the hash keys and the incrementally updated evaluation   *
+*  terms, so that move_unmake() copies them back instead of recomputing them. *
+******************************************************************************/
+
+struct sundo {
+    U64 hash;
+    U64 phash;
+    int pcsq_mg[NUM_PLAYERS];
+    int pcsq_eg[NUM_PLAYERS];
+    int piece_material[NUM_PLAYERS];
+    int pawn_material[NUM_PLAYERS];
+    char castle;
+    U8 ep;
+    U8 ply;
+};
+
 struct sboard {
     U8 pieces[NUM_SQUARES];
     U8 color[NUM_SQUARES];
+    sbitboard bb_color[NUM_PLAYERS];  // the same pieces as bitboards, by side...
+    sbitboard bb_type[NUM_TYPES];     // ...and by type, for both sides together
     char stm;        // side to move: 0 = white,  1 = black
     char castle;     // 1 = shortW, 2 = longW, 4 = shortB, 8 = longB
     U8 ep;         // en passant square
@@ -122,6 +160,7 @@ struct sboard {
     U64	phash;
     int rep_index;
     U64 rep_stack[1024];
+    sundo undo[1024];   // state before each move made, by rep_index
     U8 king_loc[NUM_PLAYERS];
     int pcsq_mg[NUM_PLAYERS];
     int pcsq_eg[NUM_PLAYERS];
@@ -131,38 +170,135 @@ struct sboard {
     U8 pawns_on_file[NUM_PLAYERS][NUM_FILES];
     U8 pawns_on_rank[NUM_PLAYERS][NUM_FILES];
     U8 pawn_ctrl[NUM_PLAYERS][NUM_SQUARES];
+#ifdef ATTACK_MAPS
+    U8 attacks[NUM_PLAYERS][NUM_SQUARES];  // number of pieces attacking a square
+#endif
 };
-extern sboard b;
 
+/******************************************************************************
+*  Every search thread works on its own copy of the board. The copies are     *
+*  kept in a plain array by thread id, and each thread reaches its own one    *
+*  through a thread-local pointer. Addressing a thread-local board directly   *
+*  made every access to b slower, while the pointer is read once per          *
+*  function and then used like any other. All the pointers start out at       *
+*  entry 0, so the main thread needs no setup; search_helper() points its     *
+*  thread to its own entry before it touches the board. The search driver sd  *
+*  is reached in the same way.                                                *
+******************************************************************************/
+
+extern sboard boards[MAX_THREADS];
+extern THREAD_PTR sboard * board_ptr;
+#define b (*board_ptr)
+
+
+/******************************************************************************
+*  A move is packed into 32 bits, so that move lists, killers and the move    *
+*  picker stay small. What is needed to take a move back (castling rights,    *
+*  en passant square and the fifty move counter) is not part of the move; it  *
+*  is kept on the board's undo stack by move_make(). Sort scores live in the  *
+*  move picker's keys, see movegen_score().                                   *
+******************************************************************************/
 
 struct smove {
-    char id;
-    U8 from;
-    U8 to;
-    U8 piece_from;
-    U8 piece_to;
-    U8 piece_cap;
-    char flags;
-    char castle;
-    char ply;
-    U8 ep;
-    int score;
+    U32 from       : 8;
+    U32 to         : 8;
+    U32 piece_from : 3;
+    U32 piece_to   : 3;
+    U32 piece_cap  : 4;   // PIECE_EMPTY if nothing is captured
+    U32 flags      : 6;   // see emflag
+};
+
+static_assert(sizeof(smove) == 4, "a move must fit into 32 bits");
+
+/******************************************************************************
+*  Compact move code, as stored in the transposition table:                   *
+*     bits  0-7   from square                                                 *
+*     bits  8-15  to square                                                   *
+*     bits 16-18  piece after the move (differs from the mover on promotion)  *
+*  A move never leads to its own square, so 0 can stand for "no move".        *
+******************************************************************************/
+
+#define NO_MOVE 0
+
+/******************************************************************************
+*  The move picker hands out the moves of a node one at a time, generating    *
+*  them in stages: the hash move first, then captures and promotions, then    *
+*  the killers and finally the quiet moves, together with the captures that   *
+*  are expected to lose material. Most cutoffs happen on one of the first     *
+*  moves, so the later stages are often never generated at all. Moves stay   *
+*  where they were generated; only their 64-bit sort keys are moved around.  *
+******************************************************************************/
+
+/* what the static exchange evaluation of movegen_score() said about a move */
+enum esee {
+    SEE_UNKNOWN,   // not a capture, or not scored by the picker
+    SEE_BAD,       // loses material
+    SEE_GOOD       // at least breaks even
+};
+
+struct smovepicker {
+    smove moves[256];
+    S64 keys[256];   // score, SEE verdict and index of each move, see PICK_KEY
+    U8 count;        // number of moves generated so far
+    U8 current;      // first key that has not been handed out yet
+    U8 stage;        // see epickstage in movegen.h
+    U8 picks;        // moves picked by scanning in the current stage
+    U8 sorted;       // the rest of the current stage is in order
+    U8 ply;          // needed to look up the killers
+    U8 victim;       // quiescence search: next entry of e.VICTIM_ORDER
+    U8 see;          // SEE verdict of the move handed out last, see esee
+    U32 hash_move;   // move code of the hash move, NO_MOVE if there is none
+    smove hash;
+    U32 killer[2];   // move codes of the killers handed out, to skip them later
+};
+
+/******************************************************************************
+*  What a legality test needs to know about the side to move. It is filled    *
+*  once per node by movegen_pins(), so that movegen_isLegal() can accept most *
+*  moves with a few masks instead of making them and looking for a check.     *
+******************************************************************************/
+
+struct spins {
+    U8 king;              // square of our king
+    sbitboard checkers;   // enemy pieces giving check
+    sbitboard pinned;     // our pieces that may move only along the line to the king
+};
+
+/******************************************************************************
+*  What a gives-check test needs to know, filled once per node by             *
+*  movegen_checks(). A move checks directly if the piece lands on one of the  *
+*  squares from which its type attacks the enemy king, or by discovery if it  *
+*  moves a candidate off the line between the king and one of our sliders.    *
+******************************************************************************/
+
+struct schecks {
+    U8 king;                        // square of the enemy king
+    sbitboard candidates;           // our pieces that may uncover a check
+    sbitboard squares[NUM_TYPES];   // where each piece type would give check
 };
 
 
 struct sSearchDriver {
+    int thread_id;   // 0 = main thread, others are Lazy SMP helpers
     int myside;
     U8 depth;
     int history[NUM_PLAYERS][NUM_SQUARES][NUM_SQUARES];
     int cutoff [NUM_PLAYERS][NUM_SQUARES][NUM_SQUARES];
     smove killers[1024][2];
+    int static_eval[1024];       // by ply, to tell if our position improves
+    U32 excluded[1024];          // by ply, move left out by the singular search
+    smove pv[MAX_PLY][MAX_PLY];  // triangular PV table, see pv_update()
+    U8 pv_length[MAX_PLY];
     U64 nodes;
     S32 movetime;
     U64 q_nodes;
     unsigned long starttime;
 };
 
-extern sSearchDriver sd;
+extern sSearchDriver drivers[MAX_THREADS];
+extern THREAD_PTR sSearchDriver * driver_ptr;
+#define sd (*driver_ptr)
+extern std::atomic<bool> time_over;
 
 enum etimef {
     FTIME=1,
@@ -201,6 +337,9 @@ extern structtime chronos;
 
 struct s_options {
 	int ponder;
+	int threads;
+	int numa;    // interleave hash table memory across NUMA nodes
+	char hash_file[256]; // transposition table file, see SetHashFile()
 
 };
 extern s_options options;
@@ -209,6 +348,7 @@ struct s_eval_data {
 
     int PIECE_VALUE[NUM_TYPES];
     int SORT_VALUE[NUM_TYPES];
+    U8 VICTIM_ORDER[NUM_TYPES];  // piece types by falling SORT_VALUE
 
     /* Piece-square tables - we use size of the board representation,
     not 0..79, to avoid re-indexing. Initialization routine, however,
@@ -259,23 +399,44 @@ void board_display();
 void clearBoard();
 void fillSq(U8 color, U8 piece, U8 sq);
 void clearSq(U8 sq);
+void putSq(U8 color, U8 piece, U8 sq);
+void takeSq(U8 sq);
 int board_loadFromFen(const char * fen);
 
 
 int com_send(const char * command);
-int com_sendmove(smove m);
+int com_sendmove(smove m, smove * ponder);
 int com_uci(char * command);
 int com_xboard(char * command);
 int com_nothing(char * command);
 int com();
 int com_init();
 int com_ismove(char * command);
+void SetThreads(int threads);
+void SetNuma(int numa);
+void SetHashFile(const char * name);
 void CheckInput();
 
 
-U8 movegen(smove * moves, U8 tt_move);
+U8 movegen(smove * moves);
+int movegen_score(smove move, U8 * see);
 U8 movegen_qs(smove * moves);
-void movegen_sort(U8 movecount, smove * m, U8 current);
+U8 movegen_quiet(smove * moves);
+U8 movegen_captures(smove * moves, U8 victim);
+U8 movegen_promotions(smove * moves);
+U8 movegen_evasions(smove * moves);
+U8 movegen_legal(smove * moves);
+void movegen_pins(spins * pins);
+int movegen_isLegal(const spins * pins, smove move);
+void movegen_checks(schecks * checks);
+int movegen_givesCheck(const schecks * checks, smove move);
+int movegen_decode(U32 code, smove * move);
+void movepicker_init(smovepicker * mp, smove * hash_move, U8 ply);
+void movepicker_initEvasions(smovepicker * mp, smove * hash_move, U8 ply);
+void movepicker_initQs(smovepicker * mp);
+int movepicker_next(smovepicker * mp, smove * move);
+int movepicker_seeGe(smovepicker * mp, smove move, int margin);
+void movegen_sort(U8 movecount, smove * m, int * scores, U8 current);
 
 
 void convert_0x88_a(U8 sq, char * a);
@@ -291,6 +452,7 @@ int move_unmakeNull(U8 ep);
 
 // the next couple of functions respond to questions about moves or move lists
 
+U32 move_encode(smove m);
 int move_iscapt(smove m);
 int move_isprom(smove m);
 int move_canSimplify(smove m);
@@ -306,7 +468,12 @@ smove strToMove(char * a);
 
 
 void search_run(); // interface of the search functions
+void search_initReductions();
 void clearHistoryTable();
+U64 search_nodes();
+
+extern int LMR_BASE;
+extern int LMR_DIVISOR;
 
 
 void setDefaultEval();
@@ -326,18 +493,23 @@ void printEvalFactor(int wh, int bl);
 
 
 int Quiesce( int alpha, int beta );
-int badCapture(smove move);
-int Blind(smove move);
+int see(smove move);
+int see_ge(smove move, int margin);
 
 int isAttacked(char byColor, U8 sq);
 int leaperAttack(char byColor, U8 sq, char byPiece);
 int knightAttack(char byColor, U8 sq);
-int straightAttack(char byColor, U8 sq, int vect);
-int diagAttack(int byColor, U8 sq, int vect);
-int bishAttack(int byColor, U8 sq, int vect);
+void attacks_init();
+sbitboard pieceAttacks(U8 sq, U8 piece, U8 color, sbitboard occ);
+sbitboard attackersOf(U8 sq, sbitboard occ);
+#ifdef ATTACK_MAPS
+void attacks_place(U8 sq, U8 piece, U8 color);
+void attacks_remove(U8 sq, U8 piece, U8 color);
+#endif
 
 void perft_start(char * command);
 U64 perft(U8 depth);
+void perft_check();
 
 void util_bench(char * command);
 int util_pv(char * pv);
@@ -7,23 +7,65 @@
 
 #include "stdafx.h"
 #include "transposition.h"
+#include "variant.h"
+#include <thread>
+#include <cstdarg>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define MPOL_INTERLEAVE 3
+#else
+#include <windows.h>
+#endif
 
 
-extern bool time_over;
-
 szobrist zobrist;
 
-stt_entry * tt;
+stt_bucket * tt;
 spawntt_entry * ptt;
 sevaltt_entry * ett;
 
-int tt_size = 0;
-int ptt_size = 0;
-int ett_size = 0;
+/* number of buckets, resp. entries in each table - zero if there is none */
+U64 tt_size = 0;
+U64 ptt_size = 0;
+U64 ett_size = 0;
+
+U8 tt_generation = 0;
+
+#define RELAXED std::memory_order_relaxed
+
+#define TT_AGE_WEIGHT 4
+
+/******************************************************************************
+*  Layout of the data word of a tt entry:                                     *
+*     bits  0-15  value                                                       *
+*     bits 16-23  depth                                                       *
+*     bits 24-25  flags                                                       *
+*     bits 26-31  generation (number of the search that wrote the entry)      *
+*     bits 32-50  bestmove, as a move code (see move_encode)                  *
+******************************************************************************/
+
+#define TT_VAL(data)        ( (int) (S16) ((data) & 0xFFFF) )
+#define TT_DEPTH(data)      ( (U8) ((data) >> 16) )
+#define TT_FLAGS(data)      ( (U8) (((data) >> 24) & 3) )
+#define TT_GENERATION(data) ( (U8) (((data) >> 26) & TT_MAX_GENERATION) )
+#define TT_MOVE(data)       ( (U32) ((data) >> 32) )
+
+U64 tt_pack(int val, U8 depth, char flags, U32 best) {
+    return (U64) (U16) val
+         | (U64) depth << 16
+         | (U64) (flags & 3) << 24
+         | (U64) tt_generation << 26
+         | (U64) best << 32;
+}
 
 /* function taken from Sungorus chess engine */
 U64 rand64() {
-    static U64 next = 1;
+    static U64 next = ZOBRIST_SEED;
 
     next = next * 1103515245 + 12345;
     return next;
@@ -59,146 +101,503 @@ int tt_init() {
     return 0;
 }
 
-int tt_setsize(int size) {
+/******************************************************************************
+*  Memory for the hash tables. Big tables are probed at random addresses, so  *
+*  on Linux we ask for 2 MB transparent huge pages, which saves most of the   *
+*  TLB misses. On request the pages are interleaved across NUMA nodes, so     *
+*  that threads running on different sockets see the same average latency.    *
+*  Windows tries large pages first and falls back to ordinary ones. Large     *
+*  pages need the "Lock pages in memory" privilege, which the user must have  *
+*  been granted and which we switch on in our process token. Either way the   *
+*  memory is then zeroed by all the search threads in parallel, which also    *
+*  faults the pages in now rather than in the middle of a search.             *
+******************************************************************************/
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+void tt_clear(void * mem, size_t size) {
+    int threads = options.threads > 1 ? options.threads : 1;
+    size_t chunk = (size / threads + 4095) & ~(size_t) 4095;
+    std::thread worker[MAX_THREADS];
+
+    for (int i = 0; i < threads; i++) {
+        size_t start = i * chunk;
+        if (start >= size) break;
+        size_t len = (start + chunk > size) ? size - start : chunk;
+        worker[i] = std::thread(memset, (char *) mem + start, 0, len);
+    }
+
+    for (int i = 0; i < threads; i++)
+        if (worker[i].joinable()) worker[i].join();
+}
+
+#ifdef __linux__
+
+/* tables need not be a power of 2, so round the mapping up to whole huge pages */
+#define HUGE_PAGE_ROUND(size) ( ((size) + HUGE_PAGE_SIZE - 1) & ~(size_t) (HUGE_PAGE_SIZE - 1) )
+
+void * tt_alloc(size_t size) {
+    void * mem;
+
+    if (size < HUGE_PAGE_SIZE) {
+        if (posix_memalign(&mem, 64, size)) return NULL;
+    } else {
+        /* over-allocate, then trim the mapping to a 2 MB boundary */
+        size_t map = HUGE_PAGE_ROUND(size);
+        size_t len = map + HUGE_PAGE_SIZE;
+        char * raw = (char *) mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) return NULL;
+
+        char * aligned = (char *) HUGE_PAGE_ROUND((size_t) raw);
+        if (aligned > raw) munmap(raw, aligned - raw);
+        munmap(aligned + map, raw + len - (aligned + map));
+        mem = aligned;
+
+        madvise(mem, map, MADV_HUGEPAGE);
+
+        /* must be set before the first touch; failure is harmless */
+        if (options.numa) {
+            unsigned long nodes = ~0UL;
+            syscall(SYS_mbind, mem, map, MPOL_INTERLEAVE, &nodes, sizeof nodes * 8, 0);
+        }
+    }
+
+    tt_clear(mem, size);
+    return mem;
+}
+
+void tt_free(void * mem, size_t size) {
+    if (size < HUGE_PAGE_SIZE) free(mem);
+    else                       munmap(mem, HUGE_PAGE_ROUND(size));
+}
+
+#else
+
+/* switches on the "Lock pages in memory" privilege, returns 0 if we don't hold it */
+int tt_lockMemory() {
+    static int enabled = -1;
+    if (enabled >= 0) return enabled;
+
+    enabled = 0;
+    HANDLE token;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+        return enabled;
+
+    TOKEN_PRIVILEGES tp;
+    tp.PrivilegeCount = 1;
+    tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+    /* AdjustTokenPrivileges() succeeds even if the privilege is not held */
+    if (LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &tp.Privileges[0].Luid)
+    &&  AdjustTokenPrivileges(token, FALSE, &tp, 0, NULL, NULL)
+    &&  GetLastError() == ERROR_SUCCESS)
+        enabled = 1;
+
+    CloseHandle(token);
+    return enabled;
+}
+
+void * tt_alloc(size_t size) {
+    void * mem = NULL;
+    SIZE_T large = GetLargePageMinimum();
+
+    if (large && size >= large && tt_lockMemory())
+        mem = VirtualAlloc(NULL, (size + large - 1) & ~(large - 1), MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    if (mem == NULL)
+        mem = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (mem == NULL) return NULL;
+
+    tt_clear(mem, size);
+    return mem;
+}
+
+void tt_free(void * mem, size_t size) {
+    VirtualFree(mem, 0, MEM_RELEASE);
+}
+
+#endif
+
+U64 tt_setsize(U64 size) {
 
     /**************************************************************************
-	*  Check if size is a power of 2. If not, make it the next lower power    *
-	*  of 2. This allows for a faster access of the entry needed:             *
-	*  as sizeof(stt_entry) in our case is 16 Bytes long (see definition of   *
-	*  stt_entry), we are creating size / 16 tt entries. The idea of making   *
-	*  the size a power of 2 is important for accessing the table. By 'anding'*
-	*  the hash value and the number of entries -1 (tt_size), we get a number *
-	*  in the range between 0 and the number of entries very quickly. This    *
-	*  number is used to index the entry.                                     *
+	*  We create size / 64 buckets, as sizeof(stt_bucket) is 64 Bytes long    *
+	*  (four 16-byte entries, see definition of stt_bucket). The number of    *
+	*  buckets need not be a power of 2: instead of 'anding' the hash value   *
+	*  with a mask, tt_index() multiplies it by the number of buckets and     *
+	*  keeps the upper 64 bits of the product, which is just as fast and      *
+	*  lets us use the whole memory we were given.                            *
     **************************************************************************/
 
 	if (tt != NULL)
-		free(tt);
-
-    if (size & (size - 1)) {
+		tt_free(tt, tt_size * sizeof(stt_bucket));
+	tt = NULL;
 
-        size--;
-        for (int i=1; i<32; i=i*2)
-            size |= size >> i;
-        size++;
-        size>>=1;
+    if (size > TT_MAX_BYTES) size = TT_MAX_BYTES;
+    tt_size = size / sizeof(stt_bucket);
+    if (!tt_size) return 0;
 
-    }
+    tt = (stt_bucket *) tt_alloc(tt_size * sizeof(stt_bucket));
 
-    if (size < 16) {
+    if (tt == NULL) {
         tt_size = 0;
         return 0;
     }
 
-    tt_size = (size / sizeof(stt_entry)) -1;
-    tt = (stt_entry *) malloc(size);
+    return tt_size * sizeof(stt_bucket);
+}
+
+/******************************************************************************
+*  tt_newSearch() is called before every search. Entries written by earlier   *
+*  searches grow older and become easier to replace.                          *
+******************************************************************************/
 
-    return size;
+void tt_newSearch() {
+    tt_generation = (tt_generation + 1) & TT_MAX_GENERATION;
 }
 
-int tt_probe(U8 depth, int alpha, int beta, char * best) {
+int tt_probe(U8 depth, int alpha, int beta, U32 * best) {
 
     if (!tt_size) return INVALID;
 
     /**************************************************************************
     *   Before  searching  a certain position, look whether we have  done  so *
     *   before. This is done by comparing the hashkey of the current position *
-    *   to the hashkey of the specific tt entry. If they are the same, we may *
-    *   use the move stored in the hash table to enhance move ordering.  When *
-    *   the previous search was not shallower then the one needed now, we may *
-    *   use  the  information present in the transposition table  to  replace *
-    *   search altogether. We do it only if the value found is in the  proper *
-    *   relation  to alpha and beta, i.e. when it would cause a cutoff.  Some *
-    *	programs  do  use these informations to narrow the window,  but  then *
-    *   you have to be extra careful to avoid search instability.             *
+    *   to the hashkeys of the entries in its bucket. If one is the same, we  *
+    *   may use the move stored in the hash table to enhance move ordering.   *
+    *   When the previous search was not shallower then the one needed now,   *
+    *   we may use the information present in the transposition table to     *
+    *   replace search altogether. We do it only if the value found is in    *
+    *   the proper relation to alpha and beta, i.e. when it would cause a     *
+    *   cutoff. Some programs do use these informations to narrow the window, *
+    *   but then you have to be extra careful to avoid search instability.    *
     **************************************************************************/
 
-    stt_entry * phashe = &tt[b.hash & tt_size];
+    stt_entry * phashe = tt[tt_index(b.hash, tt_size)].entry;
+
+    for (int i = 0; i < TT_BUCKET_SIZE; i++, phashe++) {
 
-    if (phashe->hash == b.hash) {
+        /* read each word once - another thread may be writing this entry */
+        U64 data = phashe->data.load(RELAXED);
+        U64 key = phashe->key.load(RELAXED);
+
+        if ((key ^ data) != b.hash) continue;
 
         /***************************************************
         *   The  position  matches, so  we  may  retrieve  *
         *   a move that will be used for sorting purposes  *
         ***************************************************/
 
-        *best = phashe->bestmove;
+        *best = TT_MOVE(data);
 
         /***************************************************
         *   Now test if we can retrieve position value     *
         *  ( saved depth greater than current depth )      *
         ***************************************************/
 
-        if (phashe->depth >= depth) {
+        if (TT_DEPTH(data) >= depth) {
+
+            int val = TT_VAL(data);
 
-            if (phashe->flags == TT_EXACT)
-                return phashe->val;
+            if (TT_FLAGS(data) == TT_EXACT)
+                return val;
 
-            if ((phashe->flags == TT_ALPHA) && (phashe->val <= alpha))
+            if ((TT_FLAGS(data) == TT_ALPHA) && (val <= alpha))
                 return alpha;
 
-            if ((phashe->flags == TT_BETA) && (phashe->val >= beta))
+            if ((TT_FLAGS(data) == TT_BETA) && (val >= beta))
                 return beta;
 
         }
 
+        break;
     }
 
     return INVALID;
 
 }
 
-void tt_save(U8 depth, int val, char flags, char best) {
+/******************************************************************************
+*  tt_probeEntry() reads the value, depth and bound stored for the current    *
+*  position, without testing them against a window. The singular extension   *
+*  needs them to decide whether the hash move is much better than the rest.   *
+*  Returns 0 if the position is not in the table.                             *
+******************************************************************************/
+
+int tt_probeEntry(int * val, U8 * depth, char * flags) {
+
+    if (!tt_size) return 0;
+
+    stt_entry * phashe = tt[tt_index(b.hash, tt_size)].entry;
+
+    for (int i = 0; i < TT_BUCKET_SIZE; i++, phashe++) {
+
+        U64 data = phashe->data.load(RELAXED);
+        U64 key = phashe->key.load(RELAXED);
+
+        if ((key ^ data) != b.hash) continue;
+
+        *val = TT_VAL(data);
+        *depth = TT_DEPTH(data);
+        *flags = TT_FLAGS(data);
+        return 1;
+    }
+
+    return 0;
+}
+
+void tt_save(U8 depth, int val, char flags, U32 best) {
 
     if (!tt_size) return;
     if (time_over) return;
 
-    stt_entry * phashe = &tt[b.hash & tt_size];
+    /**************************************************************************
+    *  If the position is already in its bucket, we overwrite that entry -    *
+    *  unless it comes from a deeper search, in which case we only mark it as *
+    *  belonging to the current search. Otherwise we replace the entry that   *
+    *  is worth the least: a shallow one, or one left over from an earlier    *
+    *  search. Every search that has passed since an entry has been written   *
+    *  costs it TT_AGE_WEIGHT plies of depth.                                 *
+    **************************************************************************/
 
-    if ( (phashe->hash == b.hash) && (phashe->depth > depth) ) return;
+    stt_entry * phashe = tt[tt_index(b.hash, tt_size)].entry;
+    stt_entry * replace = phashe;
+    int replace_worth = INF;
 
-    phashe->hash = b.hash;
-    phashe->val = val;
-    phashe->flags = flags;
-    phashe->depth = depth;
-    phashe->bestmove = best;
+    for (int i = 0; i < TT_BUCKET_SIZE; i++, phashe++) {
+
+        U64 data = phashe->data.load(RELAXED);
+
+        if ((phashe->key.load(RELAXED) ^ data) == b.hash) {
+            if (TT_DEPTH(data) > depth) {
+                data = tt_pack(TT_VAL(data), TT_DEPTH(data), TT_FLAGS(data), TT_MOVE(data));
+                phashe->key.store(b.hash ^ data, RELAXED);
+                phashe->data.store(data, RELAXED);
+                return;
+            }
+            replace = phashe;
+            break;
+        }
+
+        int age = (tt_generation - TT_GENERATION(data)) & TT_MAX_GENERATION;
+        int worth = TT_DEPTH(data) - TT_AGE_WEIGHT * age;
+
+        if (worth < replace_worth) {
+            replace = phashe;
+            replace_worth = worth;
+        }
+    }
+
+    U64 data = tt_pack(val, depth, flags, best);
+    replace->key.store(b.hash ^ data, RELAXED);
+    replace->data.store(data, RELAXED);
 }
 
-int ttpawn_setsize(int size) {
+/******************************************************************************
+*  The main table can be written to disk and mapped back in later, so that a  *
+*  long analysis survives a restart of the engine. The file starts with a     *
+*  header, followed by the buckets exactly as they are laid out in memory.    *
+*  Hash keys are only meaningful for the same zobrist numbers and the same    *
+*  variant, so the header records the zobrist seed and a variant id, and a    *
+*  file that does not match is rejected. The size of the file overrides the   *
+*  current size of the table.                                                 *
+******************************************************************************/
+
+#define TT_FILE_MAGIC   0x5454303857504300ULL   // "\0CPW80TT"
+#define TT_FILE_VERSION 2
+
+struct stt_file_header {
+    U64 magic;
+    U32 version;
+    U32 bucket_size;    // sizeof(stt_bucket)
+    U64 zobrist_seed;
+    U64 variant_id;
+    U64 buckets;
+    U64 generation;
+    U64 reserved[2];    // pads the header to one cache line
+};
+
+enum eproto {
+    PROTO_NOTHING,
+    PROTO_XBOARD,
+    PROTO_UCI
+} extern mode;
+
+/* a status line, which GUIs must not take for a command of the engine */
+void tt_report(const char * format, ...) {
+    va_list args;
+    va_start(args, format);
+    if (mode == PROTO_UCI)    printf("info string ");
+    if (mode == PROTO_XBOARD) printf("# ");
+    vprintf(format, args);
+    va_end(args);
+}
 
-    /* see tt_setsize for more details */
+/* FNV-1a hash of the starting position tells the variants apart */
+U64 tt_variantId() {
+    U64 id = 0xCBF29CE484222325ULL;
 
-	if (ptt != NULL)
-		free(ptt);
+    for (const char * c = cv.startFEN; *c; c++) {
+        id ^= (U8) *c;
+        id *= 0x100000001B3ULL;
+    }
+
+    return id;
+}
+
+int tt_dump(const char * name) {
+    FILE * f;
+
+    if (!tt_size) {
+        tt_report("No transposition table to save \n");
+        return -1;
+    }
+
+    if ((f = fopen(name, "wb")) == NULL) {
+        tt_report("Cannot open %s \n", name);
+        return -1;
+    }
+
+    stt_file_header header = {};
+    header.magic = TT_FILE_MAGIC;
+    header.version = TT_FILE_VERSION;
+    header.bucket_size = sizeof(stt_bucket);
+    header.zobrist_seed = ZOBRIST_SEED;
+    header.variant_id = tt_variantId();
+    header.buckets = tt_size;
+    header.generation = tt_generation;
+
+    size_t written = fwrite(&header, sizeof header, 1, f);
+    written += fwrite((void *) tt, sizeof(stt_bucket), tt_size, f);
+
+    if (fclose(f) != 0 || written != tt_size + 1) {
+        tt_report("Error writing %s \n", name);
+        return -1;
+    }
+
+    tt_report("Saved %llu MB of transposition table to %s \n", (tt_size * sizeof(stt_bucket)) >> 20, name);
+    return 0;
+}
+
+/* the old table is freed only once the new one is there, so a failure keeps it */
+int tt_resize(U64 buckets) {
+    if (buckets > TT_MAX_BYTES / sizeof(stt_bucket)) return 0;
+
+    stt_bucket * table = (stt_bucket *) tt_alloc(buckets * sizeof(stt_bucket));
+    if (table == NULL) return 0;
 
-    if (size & (size - 1)) {
+    if (tt != NULL) tt_free(tt, tt_size * sizeof(stt_bucket));
+    tt = table;
+    tt_size = buckets;
+    return 1;
+}
+
+/* map the file, check the header and copy the buckets into the table */
+int tt_load(const char * name) {
+    U64 len;
+    char * map;
+
+#ifdef __linux__
+    struct stat st;
+    int fd = open(name, O_RDONLY);
+
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        tt_report("Cannot open %s \n", name);
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+
+    len = st.st_size;
+    map = len ? (char *) mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0) : (char *) MAP_FAILED;
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        tt_report("Cannot map %s \n", name);
+        return -1;
+    }
+#else
+    HANDLE file = CreateFileA(name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    LARGE_INTEGER file_size;
+
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &file_size)) {
+        tt_report("Cannot open %s \n", name);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        return -1;
+    }
 
-        size--;
-        for (int i=1; i<32; i=i*2)
-            size |= size >> i;
-        size++;
-        size>>=1;
+    len = file_size.QuadPart;
+    HANDLE mapping = len ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    map = mapping ? (char *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (mapping) CloseHandle(mapping);
+    CloseHandle(file);
 
+    if (map == NULL) {
+        tt_report("Cannot map %s \n", name);
+        return -1;
     }
+#endif
+
+    stt_file_header header = {};
+    if (len >= sizeof header)
+        memcpy(&header, map, sizeof header);
+
+    int result = -1;
+
+    if (len < sizeof header || header.magic != TT_FILE_MAGIC
+    ||  header.version != TT_FILE_VERSION || header.bucket_size != sizeof(stt_bucket)
+    ||  !header.buckets || len != sizeof header + header.buckets * sizeof(stt_bucket))
+        tt_report("%s is not a transposition table file \n", name);
+    else if (header.zobrist_seed != ZOBRIST_SEED)
+        tt_report("%s was saved with different hash keys \n", name);
+    else if (header.variant_id != tt_variantId())
+        tt_report("%s was saved for a different variant \n", name);
+    else if (header.buckets != tt_size && !tt_resize(header.buckets))
+        tt_report("Not enough memory to load %s, the table is kept \n", name);
+    else {
+        memcpy((void *) tt, map + sizeof header, tt_size * sizeof(stt_bucket));
+        tt_generation = (U8) header.generation;
+        tt_report("Loaded %llu MB of transposition table from %s \n", (tt_size * sizeof(stt_bucket)) >> 20, name);
+        result = 0;
+    }
+
+#ifdef __linux__
+    munmap(map, len);
+#else
+    UnmapViewOfFile(map);
+#endif
+
+    return result;
+}
+
+U64 ttpawn_setsize(U64 size) {
 
-    if (size < 8) {
+    /* see tt_setsize for more details */
+
+	if (ptt != NULL)
+		tt_free(ptt, ptt_size * sizeof(spawntt_entry));
+	ptt = NULL;
+
+    if (size > TT_MAX_BYTES) size = TT_MAX_BYTES;
+    ptt_size = size / sizeof(spawntt_entry);
+    if (!ptt_size) return 0;
+
+    ptt = (spawntt_entry *) tt_alloc(ptt_size * sizeof(spawntt_entry));
+
+    if (ptt == NULL) {
         ptt_size = 0;
         return 0;
     }
 
-    ptt_size = (size / sizeof(spawntt_entry)) -1;
-    ptt = (spawntt_entry *) malloc(size);
-
-    return size;
+    return ptt_size * sizeof(spawntt_entry);
 }
 
 int ttpawn_probe() {
 
     if (!ptt_size) return INVALID;
 
-    spawntt_entry * phashe = &ptt[b.phash & ptt_size];
+    spawntt_entry * phashe = &ptt[tt_index(b.phash, ptt_size)];
 
-    if (phashe->hash == b.phash) return phashe->val;
+    U64 data = phashe->data.load(RELAXED);
+    if ((phashe->key.load(RELAXED) ^ data) == b.phash) return (int) (S32) data;
 
     return INVALID;
 
@@ -208,47 +607,43 @@ void ttpawn_save(int val) {
 
     if (!ptt_size) return;
 
-    spawntt_entry * phashe = &ptt[b.phash & ptt_size];
+    spawntt_entry * phashe = &ptt[tt_index(b.phash, ptt_size)];
 
-    phashe->hash = b.phash;
-    phashe->val = val;
+    U64 data = (U32) val;
+    phashe->key.store(b.phash ^ data, RELAXED);
+    phashe->data.store(data, RELAXED);
 }
 
-int tteval_setsize(int size) {
+U64 tteval_setsize(U64 size) {
 
     /* see tt_setsize for more details */
 
 	if (ett != NULL)
-		free(ett);
-
-    if (size & (size - 1)) {
+		tt_free(ett, ett_size * sizeof(sevaltt_entry));
+	ett = NULL;
 
-        size--;
-        for (int i=1; i<32; i=i*2)
-            size |= size >> i;
-        size++;
-        size>>=1;
+    if (size > TT_MAX_BYTES) size = TT_MAX_BYTES;
+    ett_size = size / sizeof(sevaltt_entry);
+    if (!ett_size) return 0;
 
-    }
+    ett = (sevaltt_entry *) tt_alloc(ett_size * sizeof(sevaltt_entry));
 
-    if (size < 16) {
+    if (ett == NULL) {
         ett_size = 0;
         return 0;
     }
 
-    ett_size = (size / sizeof(sevaltt_entry)) -1;
-    ett = (sevaltt_entry *) malloc(size);
-
-    return 0;
+    return ett_size * sizeof(sevaltt_entry);
 }
 
 int tteval_probe() {
 
     if (!ett_size) return INVALID;
 
-    sevaltt_entry * phashe = &ett[b.hash & ett_size];
+    sevaltt_entry * phashe = &ett[tt_index(b.hash, ett_size)];
 
-    if (phashe->hash == b.hash) return phashe->val;
+    U64 data = phashe->data.load(RELAXED);
+    if ((phashe->key.load(RELAXED) ^ data) == b.hash) return (int) (S32) data;
 
     return INVALID;
 
@@ -258,8 +653,9 @@ void tteval_save(int val) {
 
     if (!ett_size) return;
 
-    sevaltt_entry * phashe = &ett[b.hash & ett_size];
+    sevaltt_entry * phashe = &ett[tt_index(b.hash, ett_size)];
 
-    phashe->hash = b.hash;
-    phashe->val = val;
+    U64 data = (U32) val;
+    phashe->key.store(b.hash ^ data, RELAXED);
+    phashe->data.store(data, RELAXED);
 }
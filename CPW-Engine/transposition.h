@@ -6,6 +6,10 @@
 */
 
 #include "stdafx.h"
+#include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 struct szobrist {
     U64 piecesquare[NUM_TYPES][NUM_PLAYERS][NUM_SQUARES];
@@ -22,42 +26,94 @@ enum ettflag {
     TT_BETA
 };
 
+/******************************************************************************
+*  The hash tables are shared by all search threads and accessed without any  *
+*  locks. Every entry is made of two 64-bit words: data holds the packed      *
+*  search result, key holds the hash key xor'ed with data. If two threads     *
+*  write the same entry at once, key ^ data no longer gives the hash of the   *
+*  position, so a torn entry simply looks like a miss (lockless hashing by    *
+*  Robert Hyatt and Tim Mann). Both words are relaxed atomics, which compiles *
+*  to plain loads and stores, but guarantees that each word is read whole.    *
+******************************************************************************/
+
 struct stt_entry {
-    U64  hash;
-    int  val;
-    U8	 depth;
-    U8   flags;
-    U8   bestmove;
+    std::atomic<U64> key;   // hash ^ data
+    std::atomic<U64> data;  // val, depth, flags and bestmove, see tt_pack()
+};
+
+/* entries are grouped into buckets filling exactly one cache line */
+
+#define TT_BUCKET_SIZE 4
+#define TT_MAX_GENERATION 63
+
+struct alignas(64) stt_bucket {
+    stt_entry entry[TT_BUCKET_SIZE];
 };
 
-extern stt_entry* tt;
+extern stt_bucket* tt;
+extern U8 tt_generation;
 
 struct spawntt_entry {
-    U64  hash;
-    int  val;
+    std::atomic<U64> key;   // pawn hash ^ data
+    std::atomic<U64> data;  // val
 };
 
 extern spawntt_entry* ptt;
 
 struct sevaltt_entry {
-    U64 hash;
-    int val;
+    std::atomic<U64> key;   // hash ^ data
+    std::atomic<U64> data;  // val
 };
 
 extern sevaltt_entry* ett;
 
-extern int tt_size;
-extern int ptt_size;
-extern int ett_size;
+extern U64 tt_size;
+extern U64 ptt_size;
+extern U64 ett_size;
+
+/******************************************************************************
+*  Maps a hash key onto 0..size-1 by keeping the upper half of the 128-bit    *
+*  product hash * size, so the tables do not need a power-of-2 size.          *
+******************************************************************************/
+
+inline U64 tt_index(U64 hash, U64 size) {
+#if defined(__SIZEOF_INT128__)
+    return (U64) (((unsigned __int128) hash * size) >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    return __umulh(hash, size);
+#else
+    U64 hl = hash & 0xFFFFFFFF, hh = hash >> 32;
+    U64 sl = size & 0xFFFFFFFF, sh = size >> 32;
+    U64 mid = (hl * sl >> 32) + (hh * sl & 0xFFFFFFFF) + (hl * sh & 0xFFFFFFFF);
+    return hh * sh + (hh * sl >> 32) + (hl * sh >> 32) + (mid >> 32);
+#endif
+}
+
+/******************************************************************************
+*  Table sizes are counted in 64 bits, but memory is allocated by size_t. A   *
+*  32-bit build cannot address more than 4 GB, so the tables are clamped to   *
+*  SIZE_MAX bytes, and GUIs are offered no more than 2 GB of hash there.      *
+******************************************************************************/
+
+#define TT_MAX_BYTES ( (U64) SIZE_MAX )
+#define HASH_MAX_MB  ( SIZE_MAX > 0xFFFFFFFFu ? 131072 : 2048 )
+
+/* first value of the rand64() sequence the zobrist keys are drawn from */
+#define ZOBRIST_SEED 1
 
 U64 rand64();
 int tt_init();
-int tt_setsize(int size);
-int tt_probe(U8 depth, int alpha, int beta, char * best);
-void tt_save(U8 depth, int val, char flags, char best);
-int ttpawn_setsize(int size);
+U64 tt_setsize(U64 size);
+void tt_newSearch();
+int tt_probe(U8 depth, int alpha, int beta, U32 * best);
+int tt_probeEntry(int * val, U8 * depth, char * flags);
+void tt_save(U8 depth, int val, char flags, U32 best);
+U64 tt_variantId();
+int tt_dump(const char * name);
+int tt_load(const char * name);
+U64 ttpawn_setsize(U64 size);
 int ttpawn_probe();
 void ttpawn_save(int val);
-int tteval_setsize(int size);
+U64 tteval_setsize(U64 size);
 int tteval_probe();
 void tteval_save(int val);
@@ -10,43 +10,19 @@
 #include "transposition.h"
 #include "variant.h"
 
-extern bool time_over;
-
 unsigned int gettime();
 
 /* retrieving pv from hash table */
+/* writes out the principal variation collected by search_root() */
 int util_pv(char * pv) {
 
-    sboard rootb = b;
-
-    char best;
-    smove m[256];
-    int mcount = 0;
-
-    for(U8 depth=1; depth<=sd.depth; depth++) {
-
-        best = -1;
-        tt_probe(0,0,0,&best);
-
-        if (best == -1) break;
-
-        mcount = movegen(m, 0xFF);
-
-        for (int i=0; i<mcount; i++) {
-            if (m[i].id == best) {
-                move_make(m[i]);
-
-                pv = algebraic_writemove(m[i], pv);
-                pv[0] = ' ';
-                pv++;
-
-                break;
-            }
-        }
+    for (U8 i = 0; i < sd.pv_length[0]; i++) {
+        pv = algebraic_writemove(sd.pv[0][i], pv);
+        pv[0] = ' ';
+        pv++;
     }
 
     pv[0] = 0;
-    b = rootb;
     return 0;
 }
 
@@ -70,13 +46,192 @@ U64 perft(U8 depth) {
     if (depth == 0) return 1;
 
     smove m[256];
-    int mcount = movegen(m, 0xFF);
+    int mcount = movegen_legal(m);
+
+    /* the moves are legal, so at the last ply they only need to be counted */
+    if (depth == 1) return mcount;
+
+    for (int i = 0; i < mcount; i++) {
+        move_make(m[i]);
+        nodes += perft(depth - 1);
+        move_unmake(m[i]);
+    }
+
+    return nodes;
+}
+
+/******************************************************************************
+*  Self-test for move generation: perft from the start position of every      *
+*  variant, compared with node counts from the original square-by-square      *
+*  generator. Start positions never get to the special cases in four plies,   *
+*  so a few Capablanca positions follow: castling through and out of attacks, *
+*  en passant that uncovers a check along the rank, promotions that give      *
+*  check and pinned compound pieces. On the way, at every node the sliding    *
+*  attack tables are checked against attacks found by stepping along the      *
+*  rays, and the attack maps (if compiled in) against maps built from         *
+*  scratch. In check, the evasions must contain exactly the legal moves of    *
+*  the full move list, and so must the list of the legal move generator       *
+*  everywhere, and each of these moves must give check exactly when          *
+*  movegen_givesCheck() says so. Finally the bulk-counting perft() has to     *
+*  arrive at the same number.                                                 *
+******************************************************************************/
+
+static const struct {
+    const char * variant;
+    U64 nodes;
+} perft_expected[] = {
+    { "capablanca",    805128 }, { "gothic",        808984 },
+    { "moderncarrera", 786763 }, { "bird",          805899 },
+    { "carrera",       786763 }, { "embassy",       809539 },
+    { "schoolbook",    814984 }, { "grotesque",     799751 },
+    { "ladorean",      810308 }, { "univers",       813359 },
+    { "opti",          624095 }, { "victorian",     692654 },
+    { "garamond",      813407 }, { "baskerville",   778383 },
+    { "helvetica",     807951 }, { "janus",         772074 },
+    { "newchancellor", 587778 }
+};
+
+static const struct {
+    const char * fen;
+    U64 nodes;
+} perft_positions[] = {
+    { "r4k3r/10/10/10/10/6b3/10/R4K3R w KQkq - 0 1",                732231 },
+    { "r4k3r/10/2n7/10/10/10/7a2/R4K3R w KQkq - 0 1",               255049 },
+    { "r4k3r/1p8/10/10/10/10/3N2N3/R4K3R b KQkq - 0 1",             999066 },
+    { "4k5/10/4c5/10/1A8/10/10/5K3R w K - 0 1",                     405695 },
+    { "10/10/10/K1pP5r/10/10/10/5k4 w - c6 0 1",                     12097 },
+    { "5K4/10/10/10/R4pP2k/10/10/10 b - g3 0 1",                     14547 },
+    { "r1n3k4/1P2P5/10/10/10/10/2p5p1/4K4R w - - 0 1",              600362 },
+    { "4k5/1P8/10/3q6/10/6C3/6p3/4K5 w - - 0 1",                    544166 },
+    { "4k5/10/4r5/10/1b5q2/4C5/3A1C4/4K1A2c w - - 0 1",             533306 }
+};
+
+#define PERFT_CHECK_DEPTH 4
+
+static sbitboard rayAttacks(U8 sq, const char * dirs) {
+    sbitboard result = { 0, 0 };
+
+    for (int dir = 0; dir < 4; dir++)
+        for (int nextSq = sq + dirs[dir]; IS_SQ(nextSq); nextSq += dirs[dir]) {
+            result |= bb_square(nextSq);
+            if (b.pieces[nextSq] != PIECE_EMPTY) break;
+        }
+
+    return result;
+}
+
+static int slidersMatchRays() {
+    static const char straight[4] = { NORTH, SOUTH, EAST, WEST };
+    static const char diagonal[4] = { NE, NW, SE, SW };
+    sbitboard occ = b.bb_color[WHITE] | b.bb_color[BLACK];
+
+    for (int x = 0; x < NUM_SQUARES / 2; x++) {
+
+        U8 sq = ((x / NUM_RANKS) * NUM_RANKS * 2) + (x % NUM_RANKS);
+
+        if (bb_any(bb_rookAttacks(sq, occ) ^ rayAttacks(sq, straight))
+        ||  bb_any(bb_bishopAttacks(sq, occ) ^ rayAttacks(sq, diagonal)))
+            return 0;
+    }
+
+    return 1;
+}
+
+#ifdef ATTACK_MAPS
+static int attackMapsMatch() {
+    U8 attacks[NUM_PLAYERS][NUM_SQUARES] = {};
+    sbitboard occ = b.bb_color[WHITE] | b.bb_color[BLACK];
+    sbitboard pieces = occ;
+
+    while (bb_any(pieces)) {
+        U8 sq = bb_popSquare(pieces);
+        sbitboard targets = pieceAttacks(sq, b.pieces[sq], b.color[sq], occ);
+
+        while (bb_any(targets))
+            attacks[b.color[sq]][bb_popSquare(targets)]++;
+    }
+
+    return !memcmp(attacks, b.attacks, sizeof attacks);
+}
+#endif
+
+static int isLegal(smove move) {
+    move_make(move);
+    int legal = !isAttacked(b.stm, b.king_loc[!b.stm]);
+    move_unmake(move);
+    return legal;
+}
+
+/* every legal move of one list must be in the other one */
+static int legalMovesIn(smove * moves, int count, smove * other, int otherCount) {
+    for (int i = 0; i < count; i++) {
+        if (!isLegal(moves[i])) continue;
+
+        int j = 0;
+        while (j < otherCount && move_encode(other[j]) != move_encode(moves[i])) j++;
+        if (j == otherCount) return 0;
+    }
+    return 1;
+}
+
+static int evasionsMatch() {
+    smove all[256], evasions[256];
+    int allCount = movegen(all);
+    int evasionCount = movegen_evasions(evasions);
+
+    return legalMovesIn(all, allCount, evasions, evasionCount)
+        && legalMovesIn(evasions, evasionCount, all, allCount);
+}
+
+static int legalMatch() {
+    smove all[256], legal[256];
+    int allCount = movegen(all);
+    int legalCount = movegen_legal(legal);
+
+    for (int i = 0; i < legalCount; i++)
+        if (!isLegal(legal[i])) return 0;
+
+    return legalMovesIn(all, allCount, legal, legalCount)
+        && legalMovesIn(legal, legalCount, all, allCount);
+}
+
+static int checksMatch() {
+    smove legal[256];
+    int legalCount = movegen_legal(legal);
+
+    schecks checks;
+    movegen_checks(&checks);
+
+    for (int i = 0; i < legalCount; i++) {
+        move_make(legal[i]);
+        int check = isAttacked(!b.stm, b.king_loc[(U8) b.stm]);
+        move_unmake(legal[i]);
+
+        if (check != movegen_givesCheck(&checks, legal[i])) return 0;
+    }
+    return 1;
+}
+
+static U64 perft_checked(U8 depth, int * errors) {
+
+    if (depth == 0) return 1;
+
+    if (!slidersMatchRays()) ++*errors;
+#ifdef ATTACK_MAPS
+    else if (!attackMapsMatch()) ++*errors;
+#endif
+    else if (isAttacked(!b.stm, b.king_loc[(U8) b.stm]) && !evasionsMatch()) ++*errors;
+    else if (!legalMatch() || !checksMatch()) ++*errors;
+
+    U64 nodes = 0;
+    smove m[256];
+    int mcount = movegen(m);
 
     for (int i = 0; i < mcount; i++) {
         move_make(m[i]);
 
         if (!isAttacked(b.stm, b.king_loc[!b.stm]))
-            nodes += perft(depth - 1);
+            nodes += perft_checked(depth - 1, errors);
 
         move_unmake(m[i]);
     }
@@ -84,6 +239,53 @@ U64 perft(U8 depth) {
     return nodes;
 }
 
+/* perft with all the checks from the current position; returns 1 if all is well */
+static int perft_checkPosition(const char * name, U64 expected) {
+    int errors = 0;
+
+    U64 nodes = perft_checked(PERFT_CHECK_DEPTH, &errors);
+    if (perft(PERFT_CHECK_DEPTH) != nodes) errors++;
+
+    printf("%-14s %10llu  %s", name, nodes, nodes == expected ? "ok" : "WRONG");
+    if (errors) printf(", attacks wrong in %d positions", errors);
+    printf("\n");
+
+    return nodes == expected && !errors;
+}
+
+void perft_check() {
+    svariant savedVariant = cv;
+    sboard savedBoard = b;
+    int failed = 0;
+
+    printf("Perft %d for all variants\n", PERFT_CHECK_DEPTH);
+
+    for (auto & test : perft_expected) {
+        cv.VariantByName((char *) test.variant);
+        cv.FinalizeInit();
+        board_loadFromFen(cv.startFEN);
+
+        if (!perft_checkPosition(test.variant, test.nodes)) failed++;
+    }
+
+    cv.VariantByName((char *) "capablanca");
+    cv.FinalizeInit();
+
+    for (auto & test : perft_positions) {
+        board_loadFromFen(test.fen);
+
+        if (!perft_checkPosition("position", test.nodes)) {
+            printf("               in %s\n", test.fen);
+            failed++;
+        }
+    }
+
+    printf(failed ? "%d tests FAILED\n" : "all tests ok\n", failed);
+
+    cv = savedVariant;
+    b = savedBoard;
+}
+
 void util_bench(char * command) {
 	int converted;
     unsigned int starttime = gettime();
@@ -109,7 +311,8 @@ void util_bench(char * command) {
 
     if (gettime()-starttime < 1000) starttime = gettime() - 1000;
 
-    printf("Nodes:\t%d\nTime:\t%d ms\nNPS:\t%llu\n", (int) sd.nodes, gettime()-starttime, sd.nodes / ((gettime()-starttime)/1000));
+    U64 nodes = search_nodes();
+    printf("Nodes:\t%d\nTime:\t%d ms\nNPS:\t%llu\n", (int) nodes, gettime()-starttime, nodes / ((gettime()-starttime)/1000));
 
     return;
 }
@@ -125,10 +328,6 @@ smove strToMove(char * a) {
     m.piece_cap = b.pieces[m.to];
 
     m.flags = 0;
-    m.castle = 0;
-    m.ep = 0;
-    m.ply = 0;
-    m.score = 0;
 
     /* default promotion to queen */
 
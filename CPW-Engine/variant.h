@@ -118,6 +118,9 @@ struct svariant
 		archbishop = 'a';
 		chancellor = 'c';
 		StandardCastling(fen[4] == 'k');
+		// some variants drop a piece from the lineup, so restore all of it
+		static const char all_promote_types[6] = { QUEEN, CHANCELLOR, ARCHBISHOP, ROOK, BISHOP, KNIGHT };
+		memcpy(promote_types, all_promote_types, sizeof promote_types);
 		num_promote_types = 6;
 	}
 